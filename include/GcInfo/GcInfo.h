@@ -117,6 +117,8 @@ public:
   GENERIC_CONTEXTPARAM_TYPE GenericsContextParamType;
   uint32_t PSPSymOffset;
   bool HasFunclets;
+  // Number of safepoints (StackMap records) in the Function's code
+  uint32_t NumSafepoints;
 
 private:
   // Record a Stack Allocation in the FuncInfo, with appropriate
@@ -158,6 +160,10 @@ public:
                             const llvm::DataLayout &DataLayout,
                             llvm::SmallVector<uint32_t, 4> &GcPtrOffsets);
 
+  /// Map a DWARF register number to the CLR register number.
+  /// \returns REGNUM_COUNT if the register has no CLR equivalent.
+  static ICorDebugInfo::RegNum mapDwarfRegisterToRegNum(uint16_t DwarfRegNum);
+
   GcFuncInfo *newGcInfo(const llvm::Function *F);
   GcFuncInfo *getGcInfo(const llvm::Function *F);
 
@@ -172,9 +178,11 @@ public:
   /// \param JitCtx Context record for the method's jit request.
   /// \param StackMapData A pointer to the .llvm_stackmaps section
   ///        loaded in memory
+  /// \param CodeBlock A pointer to the method's hot code, used to
+  ///        determine the size of the call instruction at each safepoint
   /// \param Allocator The allocator to be used by GcInfo encoder
   GcInfoEmitter(LLILCJitContext *JitCtx, uint8_t *StackMapData,
-                GcInfoAllocator *Allocator);
+                uint8_t *CodeBlock, GcInfoAllocator *Allocator);
 
   /// Emit GC Info to the EE using GcInfoEncoder.
   void emitGCInfo();
@@ -192,18 +200,25 @@ private:
   void finalizeEncoding();
   void emitEncoding();
 
+  void mapSafepoints();
+  void decodeCallSites();
+  uint8_t getCallSiteSize(uint32_t ReturnOffset);
+
   bool needsGCInfo(const llvm::Function *F);
   bool needsPointerReporting(const llvm::Function *F);
 
   bool hasSlot(int32_t Offset) { return SlotMap.find(Offset) != SlotMap.end(); }
+  size_t getNumSlots() { return SlotMap.size() + RegisterSlotMap.size(); }
   bool isTrackedSlot(GcSlotId SlotID);
   GcSlotId getSlot(int32_t Offset, GcSlotFlags Flags);
   GcSlotId getTrackedSlot(int32_t Offset);
+  GcSlotId getTrackedRegisterSlot(uint32_t RegNum);
   GcSlotId getUntrackedSlot(int32_t Offset, bool IsPinned = false,
                             bool IsObjectRef = false);
 
   const LLILCJitContext *JitContext;
   const uint8_t *LLVMStackMapData;
+  const uint8_t *CodeBlock;
   GcInfoEncoder Encoder;
 
   // Offset to SlotID Map
@@ -222,6 +237,26 @@ private:
   //   to   Offset -> {SlotId, SlotFlags, SpBase} map
 
   llvm::DenseMap<int32_t, uint32_t> SlotMap;
+
+  // Register number to SlotID Map, for GC values that statepoint lowering
+  // kept in (callee-saved) registers across a safepoint. Register slots are
+  // always tracked, and share the tracked range with the stack slots.
+  llvm::DenseMap<uint32_t, uint32_t> RegisterSlotMap;
+
+  // Offset just past each call instruction in the code block to the size of
+  // that call. LLVM's StackMap v1 reports safepoints by the return address
+  // only, while CoreCLR expects the start and size of the call instruction.
+  llvm::DenseMap<uint32_t, uint8_t> CallSizeMap;
+
+  // The StackMap records of a GC Function, and where the Function's code
+  // starts in the code block. Record offsets are relative to that start;
+  // call sites are reported to the EE relative to the code block.
+  struct FunctionSafepoints {
+    uint32_t CodeOffset;
+    uint32_t FirstRecord;
+    uint32_t NumRecords;
+  };
+  llvm::DenseMap<const llvm::Function *, FunctionSafepoints> SafepointMap;
   GcSlotId FirstTrackedSlot;
   size_t NumTrackedSlots;
 
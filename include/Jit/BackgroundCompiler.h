@@ -0,0 +1,187 @@
+//===------------- include/Jit/BackgroundCompiler.h -------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Declaration of the background recompilation thread pool.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef BACKGROUND_COMPILER_H
+#define BACKGROUND_COMPILER_H
+
+#include "Reader/options.h"
+#include "GcInfo.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LLILCJitContext;
+
+namespace llvm {
+class Module;
+class raw_ostream;
+} // namespace llvm
+
+/// \brief A method queued for recompilation at full optimization.
+///
+/// Holds a copy of everything needed to compile the method away from the
+/// thread that read it: the reader's IR as bitcode, the frame information
+/// the reader recorded in \p GcInfo, and the options the method was read
+/// with. Nothing in a request refers to the EE or to the requesting
+/// thread's \p LLVMContext.
+struct BackgroundRequest {
+  /// \brief Stack allocation recorded by the reader.
+  struct SlotRecord {
+    uint32_t AllocaIndex; ///< Index among the function's allocas.
+    AllocaInfo Info;      ///< Flags recorded by the reader.
+  };
+
+  /// \brief Frame information recorded by the reader for one GC function.
+  struct FunctionRecord {
+    std::string Name;                    ///< Name of the function.
+    std::vector<SlotRecord> Slots;       ///< Recorded allocas.
+    uint32_t GsCkValidRangeStart;        ///< See \p GcFuncInfo.
+    uint32_t GsCkValidRangeEnd;          ///< See \p GcFuncInfo.
+    GENERIC_CONTEXTPARAM_TYPE ParamType; ///< See \p GcFuncInfo.
+  };
+
+  std::string MethodName;             ///< Name of the method.
+  uint32_t Flags;                     ///< Jit flags of the request.
+  ::Options Options;                  ///< Options the method was read with.
+  bool ContainsUnmanagedCall;         ///< Method calls unmanaged code.
+  llvm::SmallVector<char, 0> Bitcode; ///< The reader's output.
+  std::vector<FunctionRecord> Frames; ///< Reader frame information.
+  std::string CacheDirectory;         ///< Object cache to publish to.
+  llvm::SmallString<32> Key;          ///< Object cache key of the method.
+  double EnqueueTime;                 ///< Wall time the request was queued.
+};
+
+/// \brief Pool of threads that recompile hot methods at full optimization.
+///
+/// The EE offers no way to replace the code of a method once
+/// \p compileMethod has returned it, so recompiled code is published through
+/// the on-disk object cache instead: when a method misses in the cache, the
+/// requesting thread skips IR optimization and generates code at
+/// \p CodeGenOpt::None, and registers the reader's IR here. The cheap code
+/// counts its calls, and once a method has been called \p HotCallCount times
+/// it is queued for a worker. The worker optimizes and compiles the method
+/// as usual and stores the object under the key the requesting thread looked
+/// up, so that later processes find optimized code on their first call.
+/// Methods that stay cold are never recompiled.
+///
+/// Both the registered methods and the queue are bounded; requests that find
+/// no room are dropped and the method is registered again the next time it
+/// misses in the cache. Each worker owns its own \p LLILCJitPerThreadState, and so its own \p LLVMContext and
+/// target machines, exactly as a thread calling into \p compileMethod does.
+class BackgroundCompiler {
+public:
+  /// Maximum number of requests waiting for their method to get hot.
+  static const unsigned MaxPendingRequests = 1024;
+
+  /// Maximum number of requests waiting for a worker.
+  static const unsigned MaxQueueDepth = 256;
+
+  /// Number of calls after which a method is recompiled.
+  static const uint32_t HotCallCount = 30;
+
+  /// Milliseconds between checks of the call counts.
+  static const unsigned PollInterval = 50;
+
+  /// \brief Start the worker threads.
+  /// \param NumThreads Number of worker threads to start.
+  BackgroundCompiler(unsigned NumThreads);
+
+  /// Drop any queued requests and wait for the workers to finish.
+  ~BackgroundCompiler();
+
+  /// \brief Drop any queued requests and wait for the workers to finish.
+  ///
+  /// Later requests are dropped. The pool itself stays valid, since other
+  /// threads may still be jitting with it.
+  void shutdown();
+
+  /// \brief Register a method for recompilation once it gets hot.
+  ///
+  /// Must be called after the method was looked up in the object cache and
+  /// before any pass has run on the reader's output.
+  ///
+  /// \param Context               Jit context for the method being jitted.
+  /// \param CacheDirectory        Directory of the object cache.
+  /// \param Key                   Key the method was looked up with.
+  /// \param ContainsUnmanagedCall Whether the method calls unmanaged code.
+  /// \returns The counter the method's code must increment on each call, or
+  ///          nullptr if too many methods are registered or the pool is
+  ///          shutting down, and the request was dropped.
+  uint32_t *enqueue(LLILCJitContext &Context, llvm::StringRef CacheDirectory,
+                    llvm::StringRef Key, bool ContainsUnmanagedCall);
+
+  /// \brief Make the method in \p M increment \p Counter on entry.
+  ///
+  /// Counters are never freed, since the code counting calls stays in use
+  /// for the life of the process.
+  static void insertCallCounter(llvm::Module &M, uint32_t *Counter);
+
+  /// Print the queue and publishing counters to \p OS.
+  void printStatistics(llvm::raw_ostream &OS);
+
+private:
+  /// Take requests off the queue until the pool shuts down.
+  void runWorker();
+
+  /// \brief Move registered methods that have got hot to the queue, as far
+  /// as there is room. Must be called with \p Lock held.
+  void queueHotRequests();
+
+  /// \brief Hand out a zeroed call counter. Must be called with \p Lock
+  /// held.
+  uint32_t *allocateCounter();
+
+  /// \brief A method waiting to get hot.
+  struct PendingRequest {
+    std::unique_ptr<BackgroundRequest> Request; ///< The method.
+    uint32_t *Counter;                          ///< Its call counter.
+  };
+
+  /// \brief Compile \p Request and store the result in the object cache.
+  /// \returns true if an entry was written.
+  bool compile(BackgroundRequest &Request);
+
+  std::mutex Lock;                 ///< Guards the queue and the counters.
+  std::condition_variable HasWork; ///< Signalled at shutdown.
+  std::deque<std::unique_ptr<BackgroundRequest>> Queue;
+  std::vector<PendingRequest> Pending;
+  std::vector<std::thread> Workers;
+  bool IsShuttingDown;
+
+  uint32_t *FreeCounters;   ///< Counters not yet handed out.
+  unsigned NumFreeCounters; ///< Number of them.
+
+  /// \name Counters
+  //@{
+  uint64_t NumRegistered;  ///< Requests accepted.
+  uint64_t NumDropped;     ///< Requests dropped for lack of room.
+  uint64_t NumQueued;      ///< Requests whose method got hot.
+  uint64_t NumPublished;   ///< Requests that produced a cache entry.
+  uint64_t NumFailed;      ///< Requests that did not.
+  size_t MaxObservedDepth; ///< Deepest the queue has been.
+  double TotalPublishTime; ///< Sum of enqueue-to-publish times, in seconds.
+  double MaxPublishTime;   ///< Longest enqueue-to-publish time, in seconds.
+  //@}
+};
+
+#endif // BACKGROUND_COMPILER_H
@@ -0,0 +1,144 @@
+//===---------------- include/Jit/EEObjectCache.h ---------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Declaration of the on-disk compiled object cache.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef EE_OBJECTCACHE_H
+#define EE_OBJECTCACHE_H
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <vector>
+
+struct LLILCJitContext;
+class JitOptions;
+
+namespace llvm {
+
+class Module;
+
+/// \brief On-disk cache of the objects emitted for jitted methods.
+///
+/// Each entry holds the object file produced by \p orc::LLILCCompiler for a
+/// method, along with the frame information \p GcInfoRecorder extracted
+/// during codegen. Entries are keyed by a hash of the IR produced by the
+/// reader together with the jit flags and the options that influence codegen.
+/// The reader runs even when there is a cached entry: it is comparatively
+/// cheap and it resolves the method's tokens and handles afresh, so that
+///   - handles embedded in the IR as literal values become part of the key,
+///     so an entry built against different handle values is never found, and
+///   - handles referenced symbolically are relocated with the values the EE
+///     handed out to this jit request.
+///
+/// On a hit the IR optimization passes, statepoint lowering and codegen are
+/// skipped and the cached object is loaded through the usual object linking
+/// layer, so relocations, unwind and debug info are reported as usual.
+///
+/// The cache is hooked into \p orc::IRCompileLayer via the \p ObjectCache
+/// interface. Each jit request creates its own instance.
+class EEObjectCache : public ObjectCache {
+public:
+  /// Construct a cache for the method being jitted.
+  /// \param Context   Jit context for the method being jitted.
+  /// \param Directory Directory where cache entries are kept.
+  EEObjectCache(LLILCJitContext *Context, StringRef Directory);
+
+  /// \brief Look up the method in the cache.
+  ///
+  /// Must be called once the reader has finished and before any other pass
+  /// is run on the module, since the key is computed from the reader's IR.
+  ///
+  /// \param M       Module holding the method's IR.
+  /// \param Options Jit options for this request.
+  /// \returns true if a valid entry was found for the method.
+  bool lookup(Module &M, const JitOptions &Options);
+
+  /// \brief Get the key computed by the last call to \p lookup.
+  StringRef getKey() const { return Key; }
+
+  /// \brief Prepare to store an entry for \p M under a key computed
+  /// elsewhere.
+  ///
+  /// Used when \p M is a copy of the module a key was computed for, since
+  /// printing the copy need not reproduce the same key.
+  ///
+  /// \param M        Module holding the method's IR, before any pass has run.
+  /// \param EntryKey Key returned by \p getKey for the original module.
+  void prepareStore(Module &M, StringRef EntryKey);
+
+  /// \brief Hand the cached object to the compile layer.
+  /// \returns The cached object, or nullptr if there was no hit.
+  std::unique_ptr<MemoryBuffer> getObject(const Module *M) override;
+
+  /// \brief Remember the object the compile layer just produced.
+  void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override;
+
+  /// \brief Restore the frame information saved with a cached entry into the
+  /// context's \p GcInfo, in place of running \p GcInfoRecorder.
+  void restoreGcInfo();
+
+  /// \brief Write a new cache entry for the method.
+  ///
+  /// Must be called after codegen, once \p GcInfoRecorder has recorded the
+  /// frame information for the method.
+  ///
+  /// \returns true if the entry was written.
+  bool store();
+
+private:
+  /// \brief Collect the slots the reader recorded for each GC function in
+  /// \p M, in instruction order, into \p FrameInfo.
+  void numberSlots(Module &M);
+
+  /// \brief Check that every external symbol the object refers to has a
+  /// handle in this request's name to handle map.
+  bool hasValidHandles(MemoryBufferRef Obj);
+
+  /// \brief Parse the cache entry in \p Entry.
+  ///
+  /// Fills in \p CachedObject and the recorded offsets in \p FrameInfo.
+  /// \returns false if the entry is malformed or does not match the module.
+  bool parseEntry(MemoryBufferRef Entry);
+
+  /// Path of the cache entry for the current key.
+  SmallString<128> getEntryPath();
+
+  /// \brief Frame information for one recorded stack allocation.
+  struct SlotRecord {
+    WeakVH Alloca;  ///< Recorded alloca, null if it has been deleted.
+    int32_t Offset; ///< Stack offset recorded at codegen time.
+    bool IsPresent; ///< False if the record was dropped before codegen.
+  };
+
+  /// \brief Frame information for one GC function in the module.
+  struct FunctionRecord {
+    const Function *F;             ///< The function.
+    std::vector<SlotRecord> Slots; ///< Slots, in instruction order.
+    bool HasFunclets;              ///< Whether funclets were outlined.
+    uint32_t PSPSymOffset;         ///< Offset of the PSPSym slot.
+    uint32_t NumSafepoints;        ///< Number of StackMap records.
+  };
+
+  LLILCJitContext *Context;
+  SmallString<128> Directory;
+  SmallString<32> Key;
+  std::vector<FunctionRecord> FrameInfo;
+  std::unique_ptr<MemoryBuffer> CachedObject;
+  std::unique_ptr<MemoryBuffer> CompiledObject;
+};
+
+} // namespace llvm
+
+#endif // EE_OBJECTCACHE_H
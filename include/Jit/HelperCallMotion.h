@@ -0,0 +1,53 @@
+//===------------- include/Jit/HelperCallMotion.h ---------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Declaration of the pass that hoists and commons moveable helper
+/// calls.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef HELPER_CALL_MOTION_H
+#define HELPER_CALL_MOTION_H
+
+namespace llvm {
+class FunctionPass;
+} // namespace llvm
+
+/// Name of the metadata the reader attaches to helper calls that may be
+/// moved up or commoned with an identical call.
+#define MOVEABLE_HELPER_METADATA_NAME "llilc.moveable"
+
+/// \brief Counts of the moveable helper calls seen, hoisted and removed in a
+/// method.
+struct HelperCallStatistics {
+  unsigned NumCalls;   ///< Moveable helper calls found.
+  unsigned NumHoisted; ///< Calls hoisted out of at least one loop.
+  unsigned NumRemoved; ///< Calls replaced by an identical dominating call.
+};
+
+/// \brief Create a pass that hoists moveable helper calls out of loops and
+/// removes those that repeat a dominating call.
+///
+/// The reader tags the calls that fetch a class's static base, and so run
+/// its class constructor, with \p MOVEABLE_HELPER_METADATA_NAME when the
+/// constructor has already run or the class is marked beforefieldinit. Such
+/// a call is idempotent: once it has been made, making it again with the
+/// same arguments has no further effect and returns the same result. It may
+/// also be made earlier than the code asked for. The calls can't be marked
+/// readnone, since the constructor writes memory, so the usual passes leave
+/// them alone.
+///
+/// \param Statistics Counters updated as calls are found and moved.
+/// \returns The new pass.
+llvm::FunctionPass *
+createHelperCallMotionPass(HelperCallStatistics *Statistics);
+
+#endif // HELPER_CALL_MOTION_H
@@ -0,0 +1,95 @@
+//===----------------- include/Jit/JitTimeLog.h -----------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Declaration of the per-method compile time log.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef JIT_TIME_LOG_H
+#define JIT_TIME_LOG_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/// \brief Phases of a jit request that are timed separately.
+enum class JitPhase {
+  Read,       ///< Reading MSIL into LLVM IR, including inlinees.
+  Optimize,   ///< The mid-level IR optimization pipeline.
+  Safepoints, ///< Safepoint placement and statepoint rewriting.
+  Codegen,    ///< Code generation and loading of the object.
+  DebugInfo,  ///< Extracting debug info from the object, within Codegen.
+  GcInfo,     ///< Encoding the GC info and handing it to the EE.
+  NumPhases
+};
+
+/// \brief Compile time and sizes recorded for one jit request.
+struct MethodTimeRecord {
+  /// \brief Adds the time from its construction to its destruction to a
+  /// phase of a record.
+  class Scope {
+  public:
+    /// \param Record Record to update, or nullptr to measure nothing.
+    /// \param Phase  Phase to add the time to.
+    Scope(MethodTimeRecord *Record, JitPhase Phase);
+    ~Scope() { stop(); }
+
+    /// Add the time so far to the phase, and stop measuring.
+    void stop();
+
+  private:
+    MethodTimeRecord *Record;
+    JitPhase Phase;
+    double StartWallTime; ///< Wall time at construction, in seconds.
+    double StartCpuTime;  ///< Thread CPU time at construction, in seconds.
+  };
+
+  /// Wall time spent in each phase, in seconds.
+  double WallTime[(unsigned)JitPhase::NumPhases] = {};
+  /// CPU time the jitting thread spent in each phase, in seconds.
+  double CpuTime[(unsigned)JitPhase::NumPhases] = {};
+
+  uint32_t ILSize = 0;            ///< Size of the method's MSIL in bytes.
+  uint64_t ReadInstructions = 0;  ///< IR instructions produced by the reader.
+  uint64_t FinalInstructions = 0; ///< IR instructions handed to codegen.
+  uint64_t CodeSize = 0;          ///< Hot code and read-only data in bytes.
+  uint64_t StackMapSize = 0;      ///< Size of the stack map section in bytes.
+  uint64_t TempBytes = 0;         ///< Reader temporary arena usage in bytes.
+  uint64_t ProcBytes = 0;         ///< Per-request arena usage in bytes.
+  bool IsCacheHit = false;        ///< Code came from the object cache.
+};
+
+/// \brief Log of compile times and sizes, one JSON object per line.
+///
+/// Each jit request that succeeds appends one line describing the method,
+/// the sizes in \p MethodTimeRecord, and the wall and CPU milliseconds spent
+/// in each \p JitPhase. The log is shared by all threads, and lines are
+/// written whole.
+class JitTimeLog {
+public:
+  /// \brief Open the log for appending.
+  /// \param Path File to append to.
+  JitTimeLog(llvm::StringRef Path);
+
+  /// \brief Append the line for a method.
+  /// \param MethodName Name of the method.
+  /// \param Record     Times and sizes recorded for the method.
+  void write(llvm::StringRef MethodName, const MethodTimeRecord &Record);
+
+private:
+  std::mutex Lock;
+  std::unique_ptr<llvm::raw_fd_ostream> Stream;
+};
+
+#endif // JIT_TIME_LOG_H
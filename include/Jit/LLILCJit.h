@@ -18,18 +18,24 @@
 
 #include "Pal/LLILCPal.h"
 #include "Reader/options.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/ThreadLocal.h"
+#include "llvm/Target/TargetMachine.h"
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/NullResolver.h"
 #include "llvm/Config/config.h"
+#include <atomic>
 
 class ABIInfo;
+class BackgroundCompiler;
 class GcInfo;
+class JitTimeLog;
 struct LLILCJitPerThreadState;
+struct MethodTimeRecord;
 namespace llvm {
 class EEMemoryManager;
 } // namespace llvm
@@ -85,8 +91,11 @@ public:
   //@{
   llvm::LLVMContext *LLVMContext; ///< LLVM context for types and similar.
   llvm::Module *CurrentModule;    ///< Module holding LLVM IR.
-  llvm::TargetMachine *TM;        ///< Target characteristics
+  llvm::TargetMachine *TM;        ///< Target characteristics (owned by the
+                                  ///< per-thread state).
   bool HasLoadedBitCode;          ///< Flag for side-loaded LLVM IR.
+  bool IsInlinee = false;         ///< Reading a callee to be inlined into
+                                  ///< the parent context's method.
   llvm::StringMap<uint64_t> NameToHandleMap; ///< Map from global object names
                                              ///< to the corresponding CLR
                                              ///< handles.
@@ -103,6 +112,12 @@ public:
   LLILCJitPerThreadState *State; ///< Per thread state for the jit.
   //@}
 
+  /// \name Memory management
+  //@{
+  ArenaAllocator TempArena; ///< Reader-lifetime memory, reset after reading.
+  ArenaAllocator ProcArena; ///< Memory released when this request completes.
+  //@}
+
   /// \name Per invocation JIT Options
   //@{
   ::Options *Options;
@@ -118,6 +133,9 @@ public:
 
   /// \name GC Information
   ::GcInfo *GcInfo; ///< GcInfo for functions in CurrentModule
+
+  /// Compile times for this request, or nullptr if they are not logged.
+  MethodTimeRecord *TimeRecord = nullptr;
 };
 
 /// \brief This struct holds per-thread Jit state.
@@ -133,8 +151,30 @@ public:
   /// Construct a new state.
   LLILCJitPerThreadState()
       : LLVMContext(), JitContext(nullptr), ClassTypeMap(),
-        ReverseClassTypeMap(), BoxedTypeMap(), ArrayTypeMap(), FieldIndexMap() {
-  }
+        ReverseClassTypeMap(), BoxedTypeMap(), ArrayTypeMap(), FieldIndexMap(),
+        TargetMachineMap() {}
+
+  /// \brief Get a \p TargetMachine for the given codegen configuration.
+  ///
+  /// Constructing a \p TargetMachine parses subtarget features and builds
+  /// the scheduling and register tables, which is a significant fixed cost
+  /// for small methods. Machines are therefore created on first use and
+  /// cached for the lifetime of the thread.
+  ///
+  /// \param OptLevel   Codegen optimization level.
+  /// \param CodeModel  Code model to generate code for.
+  /// \param IsPrejit   True if generating NGEN or ReadyToRun code.
+  /// \param CPU        CPU to generate code for, empty for the baseline.
+  /// \param Features   Subtarget features to enable or disable.
+  /// \param ErrStr     [out] Description of the failure, if any.
+  ///
+  /// \returns The cached target machine, or nullptr if the target could not
+  /// be found.
+  llvm::TargetMachine *getTargetMachine(llvm::CodeGenOpt::Level OptLevel,
+                                        llvm::CodeModel::Model CodeModel,
+                                        bool IsPrejit, llvm::StringRef CPU,
+                                        llvm::StringRef Features,
+                                        std::string &ErrStr);
 
   /// Each thread maintains its own \p LLVMContext. This is where
   /// LLVM keeps definitions of types and similar constructs.
@@ -168,6 +208,16 @@ public:
   ///
   /// Used to build struct GEP instructions in LLVM IR for field accesses.
   std::map<CORINFO_FIELD_HANDLE, uint32_t> FieldIndexMap;
+
+  /// \brief Map from codegen configuration to the target machine created for
+  /// it.
+  ///
+  /// Keyed by codegen optimization level, code model, whether the code is
+  /// being prejitted (NGEN or ReadyToRun), CPU name and subtarget features.
+  std::map<std::tuple<llvm::CodeGenOpt::Level, llvm::CodeModel::Model, bool,
+                      std::string, std::string>,
+           std::unique_ptr<llvm::TargetMachine>>
+      TargetMachineMap;
 };
 
 /// \brief Stub \p SymbolResolver that tells dynamic linker not to apply
@@ -205,9 +255,12 @@ private:
 /// the jit library or DLL.
 ///
 /// Because the jit can be invoked re-entrantly and on multiple threads,
-/// this class itself has no mutable state. Any state kept live between
+/// this class itself has no mutable state, apart from the background
+/// compiler which is created on first use. Any state kept live between
 /// top-level invocations of the jit is held in thread local storage.
 class LLILCJit : public ICorJitCompiler {
+  friend class BackgroundCompiler;
+
 public:
   /// \brief Construct a new jit instance.
   ///
@@ -232,6 +285,14 @@ public:
                                        UINT Flags, BYTE **NativeEntry,
                                        ULONG *NativeSizeOfCode) override;
 
+  /// \brief Stop the background compiler, if it was started.
+  ///
+  /// Waits for the worker threads to finish the method they are compiling.
+  /// The pool is not freed, since other threads may still be jitting.
+  ///
+  /// \param StaticInfo Interface to the EE; unused.
+  void ProcessShutdownWork(ICorStaticInfo *StaticInfo) override;
+
   /// Clear any caches kept by the jit.
   void clearCache() override;
 
@@ -278,7 +339,62 @@ private:
   /// \returns \p true if the conversion was successful.
   bool readMethod(LLILCJitContext *JitContext, bool &ContainsUnmanagedCall);
 
+  /// \brief Run the mid-level IR optimization pipeline over a method.
+  ///
+  /// The pipeline is chosen based on the \p OptLevel in the context's
+  /// options. It must run before GC safepoint placement and statepoint
+  /// rewriting: once GC pointers are relocated through statepoints the
+  /// IR may no longer be freely transformed.
+  ///
+  /// \param JitContext Context record for the method's jit request.
+  void optimizeMethod(LLILCJitContext *JitContext);
+
+  /// \brief Insert GC safepoints and rewrite them as statepoints, as the
+  /// options for the method require.
+  ///
+  /// \param JitContext            Context record for the method's jit request.
+  /// \param ContainsUnmanagedCall Whether the method calls unmanaged code, in
+  ///                              which case GC transitions must be lowered
+  ///                              even without precise GC.
+  void placeSafepoints(LLILCJitContext *JitContext, bool ContainsUnmanagedCall);
+
+  /// Get the jit state for this thread, creating it if necessary.
+  LLILCJitPerThreadState *getPerThreadState();
+
+  /// \brief Get the background compiler, starting it if necessary.
+  ///
+  /// \param NumThreads Number of worker threads to start with, if the
+  ///                   background compiler has not been started yet.
+  BackgroundCompiler *getBackgroundCompiler(unsigned NumThreads);
+
+  /// \brief Get the compile time log, opening it if necessary.
+  ///
+  /// \param Path File to append to, if the log has not been opened yet.
+  JitTimeLog *getTimeLog(llvm::StringRef Path);
+
 public:
+  /// Get the name of the host CPU, as detected at startup.
+  llvm::StringRef getHostCPU() const { return HostCPU; }
+
+  /// \brief Get the features of the host CPU that jitted code may use.
+  ///
+  /// Starts from the features detected at startup and disables the
+  /// instruction set extensions the EE has not enabled.
+  ///
+  /// \param CpuCompileFlags Jit flags saying which instruction set
+  ///                        extensions the EE has enabled.
+  /// \param Features        [out] Map from LLVM feature name to whether
+  ///                        the feature may be used.
+  void getHostFeatures(unsigned CpuCompileFlags,
+                       llvm::StringMap<bool> &Features) const;
+
+  /// \brief Get the size in bytes of \p Vector<T> for code that may use
+  /// \p Features.
+  static unsigned getSIMDVectorLength(const llvm::StringMap<bool> &Features);
+
+  /// Get the LLVM command line options given in COMPlus_AltJitOptions.
+  llvm::StringRef getBackendOptions() const { return BackendOptions; }
+
   /// A pointer to the singleton jit instance.
   static LLILCJit *TheJit;
 
@@ -288,6 +404,21 @@ public:
 private:
   /// Thread local storage for the jit's per-thread state.
   llvm::sys::ThreadLocal<LLILCJitPerThreadState> State;
+
+  /// Pool recompiling methods at full optimization, if enabled.
+  std::atomic<BackgroundCompiler *> Background;
+
+  /// Log of per-method compile times, if enabled.
+  std::atomic<JitTimeLog *> TimeLog;
+
+  /// Name of the host CPU.
+  std::string HostCPU;
+
+  /// Features of the host CPU. Empty if they could not be detected.
+  llvm::StringMap<bool> HostFeatures;
+
+  /// LLVM command line options parsed at startup.
+  std::string BackendOptions;
 };
 
 #endif // LLILC_JIT_H
@@ -0,0 +1,49 @@
+//===----------- include/Jit/RangeCheckElimination.h ------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Declaration of the array range check elimination pass.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef RANGE_CHECK_ELIMINATION_H
+#define RANGE_CHECK_ELIMINATION_H
+
+namespace llvm {
+class FunctionPass;
+} // namespace llvm
+
+/// Name of the metadata the reader attaches to the branch of each array
+/// range check.
+#define RANGE_CHECK_METADATA_NAME "llilc.rangecheck"
+
+/// \brief Counts of the range checks seen and removed in a method.
+struct RangeCheckStatistics {
+  unsigned NumChecks;  ///< Range checks found.
+  unsigned NumRemoved; ///< Range checks proven redundant and removed.
+};
+
+/// \brief Create a pass that removes array range checks that are implied by
+/// loop bounds and other dominating conditions.
+///
+/// The pass looks for the branches the reader tagged with
+/// \p RANGE_CHECK_METADATA_NAME. A check is removed when the index is known
+/// to be non-negative and less than the length of the same array, either
+/// because a dominating branch compared the two, or because the index is a
+/// loop induction variable that starts in range and is only incremented
+/// while it stays in range. Array lengths are immutable, so two loads of the
+/// length of the same array are treated as equal.
+///
+/// \param Statistics Counters updated as checks are found and removed.
+/// \returns The new pass.
+llvm::FunctionPass *
+createRangeCheckEliminationPass(RangeCheckStatistics *Statistics);
+
+#endif // RANGE_CHECK_ELIMINATION_H
@@ -0,0 +1,47 @@
+//===---------- include/Jit/WriteBarrierElimination.h -----------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Declaration of the write barrier elimination pass.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef WRITE_BARRIER_ELIMINATION_H
+#define WRITE_BARRIER_ELIMINATION_H
+
+namespace llvm {
+class FunctionPass;
+} // namespace llvm
+
+/// \brief Counts of the write barriers seen and removed in a method.
+struct WriteBarrierStatistics {
+  unsigned NumBarriers; ///< Write barrier helper calls found.
+  unsigned NumChecked;  ///< Calls found that use the checked barrier.
+  unsigned NumRemoved;  ///< Calls replaced by plain stores.
+};
+
+/// \brief Create a pass that replaces unnecessary write barriers with plain
+/// stores.
+///
+/// The barrier lets the GC track references stored into the heap. It is not
+/// needed when
+///   - the value stored is null,
+///   - the destination is on the stack, since stack slots holding GC
+///     references are reported to the GC anyway, or
+///   - the destination is in an object allocated by the fast allocation
+///     helper with no call in between. Such an object is in the youngest
+///     generation, and no GC can happen before the store.
+///
+/// \param Statistics Counters updated as barriers are found and removed.
+/// \returns The new pass.
+llvm::FunctionPass *
+createWriteBarrierEliminationPass(WriteBarrierStatistics *Statistics);
+
+#endif // WRITE_BARRIER_ELIMINATION_H
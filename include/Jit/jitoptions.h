@@ -18,6 +18,7 @@
 #define JITOPTIONS_H
 
 #include "options.h"
+#include "llvm/ADT/StringMap.h"
 
 /// \brief The JIT options implementation.
 ///
@@ -52,7 +53,9 @@ private:
 
   /// \brief Set optimization level for the JIT.
   ///
-  /// Opt Level based on CLR provided flags and environment.
+  /// Opt Level based on CLR provided flags and environment. MinOpts
+  /// requests get \p DEBUG_CODE, since LLILC has no level that does some
+  /// but not all of the optimization pipeline.
   /// \returns Computed OptLevel
   static ::OptLevel queryOptLevel(LLILCJitContext &JitContext);
 
@@ -119,9 +122,84 @@ private:
 
   /// \brief Set SIMD intrinsics using.
   ///
-  /// \returns true if SIMD_INTRINSIC is set in the environment set.
+  /// \returns true unless COMPlus_DisableSIMDIntrinsic is set in the
+  /// environment.
   static bool queryDoSIMDIntrinsic(LLILCJitContext &JitContext);
 
+  /// \brief Set DoIROptimization based on opt level and environment.
+  ///
+  /// \param Level The opt level computed for this invocation.
+  /// \returns true if \p Level is not \p DEBUG_CODE and
+  ///  COMPlus_DisableIROptimization is not set in the environment.
+  static bool queryDoIROptimization(LLILCJitContext &JitContext,
+                                    ::OptLevel Level);
+
+  /// \brief Set DoInlining based on opt level, jit flags and environment.
+  ///
+  /// \param Level The opt level computed for this invocation.
+  /// \returns true if \p Level is not \p DEBUG_CODE, the method is not being
+  ///  compiled for ReadyToRun, and COMPlus_DisableInlining is not set in the
+  ///  environment.
+  static bool queryDoInlining(LLILCJitContext &JitContext, ::OptLevel Level);
+
+  /// \brief Set DoGuardedDevirt based on opt level, jit flags and environment.
+  ///
+  /// \param Level The opt level computed for this invocation.
+  /// \returns true if \p Level is not \p DEBUG_CODE, the method is not being
+  ///  compiled for ReadyToRun, and COMPlus_JitGuardedDevirtualization is set
+  ///  in the environment.
+  static bool queryDoGuardedDevirt(LLILCJitContext &JitContext,
+                                   ::OptLevel Level);
+
+  /// \brief Set DoImplicitNullCheck based on opt level and environment.
+  ///
+  /// \param Level The opt level computed for this invocation.
+  /// \returns true if \p Level is not \p DEBUG_CODE and
+  ///  COMPlus_JitImplicitNullChecks is set in the environment.
+  static bool queryDoImplicitNullCheck(LLILCJitContext &JitContext,
+                                       ::OptLevel Level);
+
+  /// \brief Set DoStackAllocation based on opt level, jit flags and
+  /// environment.
+  ///
+  /// \param Level The opt level computed for this invocation.
+  /// \returns true if \p Level is not \p DEBUG_CODE, the method is not being
+  ///  compiled for ReadyToRun, and COMPlus_JitStackAllocation is set in the
+  ///  environment.
+  static bool queryDoStackAllocation(LLILCJitContext &JitContext,
+                                     ::OptLevel Level);
+
+  /// \brief Get the directory of the on-disk object cache.
+  ///
+  /// \returns The value of COMPlus_LLILCObjectCache, or an empty string if
+  ///  the object cache is disabled.
+  static std::string queryObjectCachePath(LLILCJitContext &JitContext);
+
+  /// \brief Get the number of background recompilation threads.
+  ///
+  /// \returns The value of COMPlus_LLILCBackgroundJit, or 0 if background
+  ///  recompilation is disabled.
+  static unsigned queryBackgroundThreads(LLILCJitContext &JitContext);
+
+  /// \brief Get the file to log compile times to.
+  ///
+  /// \returns The value of COMPlus_LLILCTimeLog, or an empty string if
+  ///  compile times are not logged.
+  static std::string queryTimeLogPath(LLILCJitContext &JitContext);
+
+  /// \brief Get the CPU and subtarget features to generate code for.
+  ///
+  /// Jitted code targets the host CPU, less the instruction set extensions
+  /// the EE has not enabled in the jit flags. Prejitted code targets the
+  /// baseline. COMPlus_LLILCTargetCPU replaces the CPU and its features, and
+  /// COMPlus_LLILCTargetFeatures enables or disables individual features.
+  ///
+  /// \param CPU      [out] Name of the CPU, empty for the baseline.
+  /// \param Features [out] Map from LLVM feature name to whether the
+  ///                 feature is enabled.
+  static void queryTarget(LLILCJitContext &JitContext, std::string &CPU,
+                          llvm::StringMap<bool> &Features);
+
 public:
   bool IsAltJit;        ///< True if running as the alternative JIT.
   bool IsExcludeMethod; ///< True if method is to be excluded.
@@ -130,6 +208,9 @@ public:
   bool IsMSILDumpMethod;  ///< True if dump of MSIL requested.
   bool IsLLVMDumpMethod;  ///< True if dump of LLVM requested.
   bool IsCodeRangeMethod; ///< True if desired to dump entry address and size.
+  std::string ObjectCachePath; ///< Directory of the object cache, if any.
+  unsigned BackgroundThreads;  ///< Threads recompiling into the object cache.
+  std::string TimeLogPath;     ///< File to log compile times to, if any.
 
 private:
   static MethodSet AltJitMethodSet;     ///< Singleton AltJit MethodSet.
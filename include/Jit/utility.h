@@ -19,6 +19,7 @@
 #include <list>
 #include <cassert>
 #include <memory>
+#include <vector>
 
 #include "cor.h"
 #include "utility.h"
@@ -26,6 +27,7 @@
 #include "llvm/Support/Atomic.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Allocator.h"
 
 // The MethodID.NumArgs field may hold either of 2 values:
 //   Empty   => the input string was all-blank, or empty.
@@ -166,6 +168,52 @@ private:
   std::list<MethodID> *MethodIDList = nullptr;
 };
 
+/// \brief Bump-pointer arena for memory whose lifetime is bounded by a jit
+/// request.
+///
+/// Allocations are zero-initialized and are released all at once when the
+/// arena is reset or destroyed, rather than individually. Objects with
+/// non-trivial destructors placed in the arena must be registered via
+/// \p registerDestructor so they are destroyed before their memory is
+/// released.
+class ArenaAllocator {
+public:
+  ArenaAllocator() : Allocator(), Destructors(), TotalBytesAllocated(0) {}
+
+  /// Destroy registered objects and release all memory.
+  ~ArenaAllocator() { reset(); }
+
+  /// Allocate zero-initialized memory from the arena.
+  /// \param NumBytes Size of the request in bytes.
+  /// \returns Pointer to the new memory, suitably aligned for any type.
+  void *allocate(size_t NumBytes);
+
+  /// Arrange for the destructor of \p Object to run when the arena is reset.
+  /// \param Object Object constructed in memory obtained from this arena.
+  template <typename T> void registerDestructor(T *Object) {
+    Destructors.emplace_back([](void *P) { static_cast<T *>(P)->~T(); },
+                             Object);
+  }
+
+  /// Destroy registered objects and make all arena memory available for
+  /// reuse. The first slab is retained to serve later requests.
+  void reset();
+
+  /// \returns Number of bytes handed out since the last reset.
+  size_t getBytesAllocated() const { return Allocator.getBytesAllocated(); }
+
+  /// \returns Number of bytes handed out over the lifetime of the arena.
+  size_t getTotalBytesAllocated() const { return TotalBytesAllocated; }
+
+  /// \returns Number of bytes currently reserved from the system.
+  size_t getTotalMemory() const { return Allocator.getTotalMemory(); }
+
+private:
+  llvm::BumpPtrAllocator Allocator;
+  std::vector<std::pair<void (*)(void *), void *>> Destructors;
+  size_t TotalBytesAllocated;
+};
+
 /// \brief Class implementing miscellaneous conversion functions.
 class Convert {
 public:
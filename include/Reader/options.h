@@ -18,13 +18,15 @@
 #define OPTIONS_H
 
 #include "utility.h"
+#include <string>
 
 struct LLILCJitContext;
 
 /// \brief Enum for JIT optimization level.
 enum class OptLevel {
   INVALID,
-  DEBUG_CODE,   ///< No/Low optimization to preserve debug semantics.
+  DEBUG_CODE,   ///< No/Low optimization to preserve debug semantics. Also
+                ///< used for MinOpts requests.
   BLENDED_CODE, ///< Fast code that remains sensitive to code size.
   SMALL_CODE,   ///< Optimized for small size.
   FAST_CODE     ///< Optimized for speed.
@@ -57,7 +59,15 @@ struct Options {
   bool LogGcInfo;           ///< Generate GCInfo Translation logs
   bool ExecuteHandlers;     ///< Squelch handler suppression.
   bool DoSIMDIntrinsic;     ///< True if SIMD intrinsic is on.
+  bool DoIROptimization;    ///< Run the mid-level IR optimization pipeline.
+  bool DoInlining;          ///< Inline small callees while reading MSIL.
+  bool DoGuardedDevirt;     ///< Guard virtual calls with a class check.
+  bool DoImplicitNullCheck; ///< Let codegen fold null checks into loads.
+  bool DoStackAllocation;   ///< Allocate non-escaping objects on the stack.
   unsigned PreferredIntrinsicSIMDVectorLength; ///< Prefer Intrinsic SIMD Vector
   /// Length in bytes.
+  std::string TargetCPU;      ///< CPU to generate code for. Empty for the
+                              ///< baseline of the target.
+  std::string TargetFeatures; ///< Subtarget features to enable or disable.
 };
 #endif // OPTIONS_H
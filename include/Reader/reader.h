@@ -268,7 +268,21 @@ enum ReaderSIMDIntrinsic {
   EQ,
   NEQ,
   GETCOUNTOP,
-  GETITEM
+  GETITEM,
+  NEG,
+  NOT,
+  ANDNOT,
+  GT,
+  GE,
+  LT,
+  LE,
+  EQMASK,
+  CONDSELECT,
+  DOT,
+  WIDEN,
+  NARROW,
+  CONVERT,
+  COPYTO
 };
 
 /// Common base class for reader exceptions
@@ -599,6 +613,9 @@ private:
   CORINFO_RESOLVED_TOKEN ResolvedToken;           ///< Info on the method token
   CORINFO_RESOLVED_TOKEN ResolvedConstraintToken; ///< Info on constraints
   CORINFO_CALL_INFO CallInfo;                     ///< Info from the EE
+  CORINFO_CLASS_HANDLE GuardClass;                ///< Likely class of \p this
+                                                  ///< for guarded
+                                                  ///< devirtualization.
   DelegateCtorArgs *CtorArgs;                     ///< Args to pass to delegate
                                                   ///< ctor when optimized.
   IRNode *TargetMethodHandleNode;                 ///< Client IR for target
@@ -693,6 +710,17 @@ public:
   /// \returns      Client IR node for the call target.
   IRNode *getCallTargetNode() { return CallTargetNode; }
 
+  /// \brief Get the class this call was guarded on for devirtualization.
+  ///
+  /// When this returns a class, the reader has not generated the call
+  /// target. The client should compare the method table of \p this against
+  /// the class, call the target method directly when they match, and
+  /// otherwise generate the target with \p rdrMakeCallTargetNode and make
+  /// the call as usual.
+  ///
+  /// \returns      The guard class, or nullptr if the call is not guarded.
+  CORINFO_CLASS_HANDLE getGuardClass() { return GuardClass; }
+
   /// \brief Get the class attributes for the call target method's class.
   ///
   /// Gets the target method's class attributes as reported by the CoreCLR EE.
@@ -1376,7 +1404,10 @@ protected:
   // Compiling with this set to false isn't really supported (the generated IR
   // would not have sufficient EH annotations), but it is provided as a mock
   // configuration flag to facilitate experimenting with what the IR/codegen
-  // could look like with null checks folded onto loads/stores.
+  // could look like with null checks folded onto loads/stores.  Folding is
+  // instead left to codegen: when COMPlus_JitImplicitNullChecks is set, the
+  // explicit checks outside of protected regions are marked so that LLVM's
+  // implicit null check pass may fold them onto the following access.
   static const bool UseExplicitNullChecks = true;
 
   // \brief Indicates that divide-by-zero checks use explicit compare+branch IR
@@ -1590,6 +1621,15 @@ public:
   /// \returns true if simd intrinsic opt is enabled.
   virtual bool doSimdIntrinsicOpt() = 0;
 
+  /// \brief Check options as to whether to guard virtual calls with a class
+  /// check and call the likely target directly.
+  ///
+  /// Derived class will provide an implementation that is correct for the
+  /// client.
+  ///
+  /// \returns true if guarded devirtualization is enabled.
+  virtual bool doGuardedDevirtualization() = 0;
+
 private:
   /// \brief Determine if a call instruction is a candidate to be a tail call.
   ///
@@ -2255,12 +2295,16 @@ public:
                          Caller);
   }
 
-private:
+protected:
+  /// \brief Generate IR for getting the target of the call described by
+  /// \p CallTargetData, and record it there.
+  ///
+  /// \param CallTargetData Information about the call site.
+  /// \param ThisPointer    Pointer to the call's \p this argument, if any;
+  ///                       may be updated if computing the target needs it.
   void rdrMakeCallTargetNode(ReaderCallTargetData *CallTargetData,
                              IRNode **ThisPointer);
 
-  IRNode *rdrGetDirectCallTarget(ReaderCallTargetData *CallTargetData);
-
   /// \brief Generate IR for getting the target of a direct call. "Direct call"
   /// can either be a true direct call if the runtime allows, or it can be an
   /// indirect call through the method descriptor.
@@ -2278,6 +2322,25 @@ private:
                                  mdToken MethodToken,
                                  CORINFO_LOOKUP CodePointerLookup,
                                  bool NeedsNullCheck, bool CanMakeDirectCall);
+
+private:
+  /// \brief Try to turn a virtual call into a direct call.
+  ///
+  /// If the exact class of the \p this argument is known and it is the class
+  /// that declares the target method, the call is rewritten into a direct
+  /// call to that method. Otherwise, if the client asks for guarded
+  /// devirtualization and the declaring class can be identified from its
+  /// method table alone, that class is recorded as the call's guard class;
+  /// the client is then responsible for generating both the direct call and
+  /// the virtual dispatch, see \p ReaderCallTargetData::getGuardClass.
+  ///
+  /// \param CallTargetData Information about the call site.
+  /// \param ThisPointer    Pointer to the call's \p this argument, if any.
+  void rdrDevirtualizeCall(ReaderCallTargetData *CallTargetData,
+                           IRNode **ThisPointer);
+
+  IRNode *rdrGetDirectCallTarget(ReaderCallTargetData *CallTargetData);
+
   IRNode *
   rdrGetCodePointerLookupCallTarget(ReaderCallTargetData *CallTargetData);
 
@@ -2918,6 +2981,16 @@ public:
   /// \returns             true iff Result represents the sqrt
   virtual bool sqrt(IRNode *Argument, IRNode **Result) = 0;
 
+  /// Optionally generate inline code for a \p Math method that takes a
+  /// single double.
+  ///
+  /// \param IntrinsicID   which method is being called
+  /// \param Argument      input value for the method
+  /// \param Result [out]  resulting value, iff reader decided to expand
+  /// \returns             true iff Result represents the method's result
+  virtual bool mathIntrinsic(CorInfoIntrinsics IntrinsicID, IRNode *Argument,
+                             IRNode **Result) = 0;
+
   virtual bool interlockedIntrinsicBinOp(IRNode *Arg1, IRNode *Arg2,
                                          IRNode **RetVal,
                                          CorInfoIntrinsics IntrinsicID) = 0;
@@ -2945,9 +3018,20 @@ public:
                            ReaderAlignType Alignment, bool IsVolatilePrefix);
   virtual void nop() = 0;
 
-  virtual void insertIBCAnnotations() = 0;
-  virtual IRNode *insertIBCAnnotation(FlowGraphNode *Node, uint32_t Count,
-                                      uint32_t Offset) = 0;
+  /// \brief Set up the block profile for the method.
+  ///
+  /// Only MSIL blocks are profiled, and each is identified by its starting
+  /// MSIL offset. When the EE asks for instrumentation, a counter is
+  /// allocated for each block and the client is asked to increment it. When
+  /// the EE asks for the profile to be used, the client is handed the count
+  /// the EE recorded for each block.
+  void insertIBCAnnotations();
+
+  /// Have \p Node increment the 32 bit \p Counter each time it runs.
+  virtual void insertIBCCounter(FlowGraphNode *Node, uint32_t *Counter) = 0;
+
+  /// Note that \p Node ran \p Count times when the method was profiled.
+  virtual void insertIBCAnnotation(FlowGraphNode *Node, uint32_t Count) = 0;
 
   // Insert class constructor
   virtual void insertClassConstructor();
@@ -3315,6 +3399,20 @@ public:
   /// \returns The class handle that corresponds to the type of the node.
   virtual CORINFO_CLASS_HANDLE inferThisClass(IRNode *ThisArgument) = 0;
 
+  /// \brief Get the exact class of the object the given IR node refers to,
+  ///        if it is known.
+  ///
+  /// \param ThisArgument  The IR node that represents the 'this' argument.
+  /// \returns The exact class of the object, or nullptr if it is not known.
+  virtual CORINFO_CLASS_HANDLE getExactThisClass(IRNode *ThisArgument) = 0;
+
+  /// \brief Check whether an address is known to be within an object on the
+  ///        GC heap.
+  ///
+  /// \param Address  The IR node that represents the address.
+  /// \returns true if \p Address is computed from an object reference.
+  virtual bool isHeapAddress(IRNode *Address) = 0;
+
   // Called once region tree has been built.
   virtual void setEHInfo(EHRegion *EhRegionTree,
                          EHRegionList *EhRegionList) = 0;
@@ -3380,12 +3478,17 @@ public:
   /// \brief It gets arguments from stack.
   ///
   /// \param OperationCode code to be done.
+  /// \param Class The class handle of the vector operands.
+  /// \param SigInfo info for the target Method.
   /// \returns an IRNode representing the result of the intrinsic
   /// or nullptr if the intrinsic is not supported.
 
   IRNode *generateSIMDBinOp(ReaderSIMDIntrinsic OperationCode,
-                            CORINFO_CLASS_HANDLE Class);
-  IRNode *generateSIMDUnOp(ReaderSIMDIntrinsic OperationCode);
+                            CORINFO_CLASS_HANDLE Class,
+                            CORINFO_SIG_INFO *SigInfo);
+  IRNode *generateSIMDUnOp(ReaderSIMDIntrinsic OperationCode,
+                           CORINFO_CLASS_HANDLE Class,
+                           CORINFO_SIG_INFO *SigInfo);
 
   /// \brief Return IRNode* Result of BinOp.
   ///
@@ -3412,6 +3515,42 @@ public:
 
   virtual IRNode *vectorEqual(IRNode *Vector1, IRNode *Vector2) = 0;
   virtual IRNode *vectorNotEqual(IRNode *Vector1, IRNode *Vector2) = 0;
+  virtual IRNode *vectorAndNot(IRNode *Vector1, IRNode *Vector2) = 0;
+  virtual IRNode *vectorNarrow(IRNode *Vector1, IRNode *Vector2) = 0;
+
+  /// \brief Return IRNode* Result of comparing all elements.
+  ///
+  /// \param Vector1 the first vector to compare.
+  /// \param Vector2 the second vector to compare.
+  /// \param IsNotEqual true to test whether any elements differ.
+  /// \returns an IRNode representing the bool result of the compare
+  /// or nullptr if the compare is not supported.
+  virtual IRNode *vectorAllEqual(IRNode *Vector1, IRNode *Vector2,
+                                 bool IsNotEqual) = 0;
+
+  /// \brief Return IRNode* Result of comparing each pair of elements.
+  ///
+  /// \param OperationCode one of GT, GE, LT, LE or EQMASK.
+  /// \param Vector1 the first vector to compare.
+  /// \param Vector2 the second vector to compare.
+  /// \param IsSigned true if the elements are signed.
+  /// \param ResultClass The class handle of the result vector.
+  /// \returns an IRNode whose elements are all ones where the compare holds
+  /// and zero elsewhere, or nullptr if the compare is not supported.
+  virtual IRNode *vectorCompare(ReaderSIMDIntrinsic OperationCode,
+                                IRNode *Vector1, IRNode *Vector2,
+                                bool IsSigned,
+                                CORINFO_CLASS_HANDLE ResultClass) = 0;
+
+  /// \brief Return IRNode* Dot product of two vectors.
+  ///
+  /// \param Vector1 the first vector.
+  /// \param Vector2 the second vector.
+  /// \param ResType type of the result.
+  /// \returns an IRNode representing the sum of the products of the elements
+  /// or nullptr if the dot product is not supported.
+  virtual IRNode *vectorDot(IRNode *Vector1, IRNode *Vector2,
+                            CorInfoType ResType) = 0;
 
   /// \brief Return IRNode* Result of UnOp.
   ///
@@ -3420,6 +3559,56 @@ public:
   /// or nullptr if UnOp is not supported.
   virtual IRNode *vectorAbs(IRNode *Vector) = 0;
   virtual IRNode *vectorSqrt(IRNode *Vector) = 0;
+  virtual IRNode *vectorNeg(IRNode *Vector) = 0;
+  virtual IRNode *vectorNot(IRNode *Vector) = 0;
+
+  /// \brief Return IRNode* Vector converted element by element.
+  ///
+  /// \param Vector  the vector to convert.
+  /// \param IsSigned true if the elements of \p Vector are signed.
+  /// \param ResultClass The class handle of the result vector.
+  /// \returns an IRNode representing the converted vector
+  /// or nullptr if the conversion is not supported.
+  virtual IRNode *vectorConvert(IRNode *Vector, bool IsSigned,
+                                CORINFO_CLASS_HANDLE ResultClass) = 0;
+
+  /// \brief Return result of ConditionalSelect on SIMD Vector Types.
+  /// \brief It gets arguments from stack.
+  ///
+  /// \returns an IRNode representing the result of ConditionalSelect
+  /// or nullptr if it is not supported.
+  IRNode *generateSIMDConditionalSelect();
+
+  /// \brief Return IRNode* Elements of \p Vector1 where \p Mask is set and
+  /// of \p Vector2 elsewhere.
+  ///
+  /// \param Mask vector selecting bits of \p Vector1.
+  /// \param Vector1 the first vector.
+  /// \param Vector2 the second vector.
+  /// \returns an IRNode representing the selected bits
+  /// or nullptr if the operation is not supported.
+  virtual IRNode *vectorConditionalSelect(IRNode *Mask, IRNode *Vector1,
+                                          IRNode *Vector2) = 0;
+
+  /// \brief Return result of Widen on SIMD Vector Types.
+  /// \brief It gets arguments from stack.
+  ///
+  /// \param Class The class handle of the source vector.
+  /// \returns an IRNode representing the stores of the widened halves
+  /// or nullptr if Widen is not supported.
+  IRNode *generateSIMDWiden(CORINFO_CLASS_HANDLE Class);
+
+  /// \brief Return IRNode* Stores of the two halves of \p Vector, each
+  /// converted to elements of twice the size.
+  ///
+  /// \param Vector the vector to widen.
+  /// \param LowPointer address to store the low half at.
+  /// \param HighPointer address to store the high half at.
+  /// \param IsSigned true if the elements of \p Vector are signed.
+  /// \returns an IRNode representing the stores
+  /// or nullptr if Widen is not supported.
+  virtual IRNode *vectorWiden(IRNode *Vector, IRNode *LowPointer,
+                              IRNode *HighPointer, bool IsSigned) = 0;
 
   /// \brief Return result of ctor operation on SIMD Vector Types.
   ///
@@ -3461,6 +3650,23 @@ public:
   virtual IRNode *vectorGetItem(IRNode *VectorPointer, IRNode *Index,
                                 CorInfoType ResType) = 0;
 
+  /// \brief Return result of CopyTo operation on SIMD Vector Types.
+  ///
+  /// \param ArgsCount Number of arguments on stack for call.
+  /// \returns an IRNode representing the store to the array
+  /// or nullptr if CopyTo is not supported.
+  IRNode *generateSIMDCopyTo(int ArgsCount);
+
+  /// \brief Return IRNode* Store of a vector into an array.
+  ///
+  /// \param VectorPointer is address of vector.
+  /// \param Array the array to store into.
+  /// \param Index of the first element to store to, or nullptr for 0.
+  /// \returns an IRNode representing the store
+  /// or nullptr if CopyTo is not supported.
+  virtual IRNode *vectorCopyTo(IRNode *VectorPointer, IRNode *Array,
+                               IRNode *Index) = 0;
+
   /// \brief Return IRNode* The result of the intrinsic or nullptr, if it is
   /// unnsupported.
   ///
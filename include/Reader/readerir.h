@@ -27,6 +27,8 @@
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/IR/ValueMap.h"
 #include "GcInfo.h"
 #include "reader.h"
 #include "abi.h"
@@ -37,6 +39,18 @@ class ABISignature;
 class ABICallSignature;
 class ABIMethodSignature;
 
+/// Name of the metadata the reader attaches to each call to a runtime helper.
+/// The metadata holds the number of the helper called, and is kept when the
+/// call is inlined into another method.
+#define HELPER_CALL_METADATA_NAME "llilc.helper"
+
+/// \brief Get the runtime helper an instruction calls.
+///
+/// \param Call The instruction to examine.
+/// \returns The helper called, or \p CORINFO_HELP_UNDEF if \p Call is not
+/// a call to a helper made by the reader.
+CorInfoHelpFunc getHelperCallId(const llvm::Instruction *Call);
+
 class FlowGraphNode : public llvm::BasicBlock {};
 
 /// \brief Information associated with a Basic Block (aka Flow Graph Node)
@@ -192,6 +206,7 @@ public:
         UnmanagedCallFrame(nullptr), ThreadPointer(nullptr),
         BuiltinObjectType(nullptr), ElementToArrayTypeMap() {
     this->JitContext = JitContext;
+    this->Function = nullptr;
     this->NameToHandleMap = &JitContext->NameToHandleMap;
     // Cache a few things from the per-thread state.
     LLILCJitPerThreadState *State = JitContext->State;
@@ -268,9 +283,15 @@ public:
   void condBranch(ReaderBaseNS::CondBranchOpcode Opcode, IRNode *Arg1,
                   IRNode *Arg2) override;
   IRNode *conv(ReaderBaseNS::ConvOpcode Opcode, IRNode *Source) override;
+  void cpBlk(IRNode *ByteCount, IRNode *SourceAddress,
+             IRNode *DestinationAddress, ReaderAlignType Alignment,
+             bool IsVolatile) override;
 
   void dup(IRNode *Opr, IRNode **Result1, IRNode **Result2) override;
   void endFilter(IRNode *Arg1) override;
+  void initBlk(IRNode *NumBytes, IRNode *ValuePerByte,
+               IRNode *DestinationAddress, ReaderAlignType Alignment,
+               bool IsVolatile) override;
 
   FlowGraphEdgeIterator fgNodeGetSuccessors(FlowGraphNode *FgNode) override;
   FlowGraphEdgeIterator fgNodeGetPredecessors(FlowGraphNode *FgNode) override;
@@ -428,6 +449,8 @@ public:
 
   IRNode *stringGetChar(IRNode *Arg1, IRNode *Arg2) override;
   bool sqrt(IRNode *Argument, IRNode **Result) override;
+  bool mathIntrinsic(CorInfoIntrinsics IntrinsicID, IRNode *Argument,
+                     IRNode **Result) override;
 
   bool interlockedIntrinsicBinOp(IRNode *Arg1, IRNode *Arg2, IRNode **RetVal,
                                  CorInfoIntrinsics IntrinsicID) override;
@@ -448,11 +471,8 @@ public:
 
   void nop() override;
 
-  void insertIBCAnnotations() override;
-  IRNode *insertIBCAnnotation(FlowGraphNode *Node, uint32_t Count,
-                              uint32_t Offset) override {
-    throw NotYetImplementedException("insertIBCAnnotation");
-  };
+  void insertIBCCounter(FlowGraphNode *Node, uint32_t *Counter) override;
+  void insertIBCAnnotation(FlowGraphNode *Node, uint32_t Count) override;
 
   //
   // REQUIRED Client Helper Routines.
@@ -852,6 +872,10 @@ public:
 
   CORINFO_CLASS_HANDLE inferThisClass(IRNode *ThisArgument) override;
 
+  CORINFO_CLASS_HANDLE getExactThisClass(IRNode *ThisArgument) override;
+
+  bool isHeapAddress(IRNode *Address) override;
+
   // Called once region tree has been built.
   void setEHInfo(EHRegion *EhRegionTree, EHRegionList *EhRegionList) override;
 
@@ -1474,10 +1498,129 @@ private:
   /// Provides client specific Options look up.
   bool doSimdIntrinsicOpt() override;
 
+  /// \brief Override of doGuardedDevirtualization method
+  /// Provides client specific Options look up.
+  bool doGuardedDevirtualization() override;
+
   /// If isZeroInitLocals() returns true, zero intitialize all locals;
   /// otherwise, zero initialize all gc pointers and structs with gc pointers.
   void zeroInitLocals();
 
+  /// \brief Remember a call site whose callee may be inlined.
+  ///
+  /// Only direct calls to a known method, made outside of any EH region,
+  /// are considered. The decision is deferred until the caller has been
+  /// read completely, see \p inlineCalls.
+  ///
+  /// \param CallTargetInfo Information about the call target.
+  /// \param Call           The call emitted for the call site.
+  void noteInlineCandidate(ReaderCallTargetData *CallTargetInfo,
+                           IRNode *Call);
+
+  /// \brief Remember a call site whose callee is known to be \p Callee,
+  /// even though the call target data describes a virtual call.
+  ///
+  /// \param CallTargetInfo Information about the call target.
+  /// \param Call           The call emitted for the call site.
+  /// \param Callee         The method called.
+  void noteInlineCandidate(ReaderCallTargetData *CallTargetInfo, IRNode *Call,
+                           CORINFO_METHOD_HANDLE Callee);
+
+  /// \brief Emit a virtual call guarded for devirtualization.
+  ///
+  /// Compares the method table of \p this against the call's guard class,
+  /// calls the target method directly if they match and makes the virtual
+  /// call otherwise. See \p ReaderCallTargetData::getGuardClass.
+  ///
+  /// \param CallTargetInfo Information about the call target.
+  /// \param ABICallSig     ABI signature of the call.
+  /// \param MayThrow       True if the callee may throw.
+  /// \param Args           The call's arguments as read from the stack.
+  /// \param Arguments      The call's arguments, converted to their types.
+  /// \param CallNode       [out] The virtual call.
+  /// \returns The merged result of the two calls, or nullptr if the call
+  /// returns void.
+  llvm::Value *genGuardedCall(ReaderCallTargetData *CallTargetInfo,
+                              ABICallSignature &ABICallSig, bool MayThrow,
+                              std::vector<IRNode *> &Args,
+                              llvm::ArrayRef<llvm::Value *> Arguments,
+                              IRNode **CallNode);
+
+  /// \brief Expand a castclass or isinst to a sealed class inline.
+  ///
+  /// The object is an instance of a sealed class exactly when its method
+  /// table is the class handle, so isinst needs no helper call at all, and
+  /// castclass only calls the helper, out of line, when the check fails.
+  ///
+  /// \param ClassHandleNode Handle of the class to cast to.
+  /// \param ObjRefNode      Object being cast.
+  /// \param HelperId        Helper the cast would otherwise call.
+  /// \param ResultType      Type of the cast's result.
+  /// \returns The result of the cast.
+  IRNode *genInlineCast(IRNode *ClassHandleNode, IRNode *ObjRefNode,
+                        CorInfoHelpFunc HelperId, llvm::Type *ResultType);
+
+  /// \brief Convert a method pointer used as a call target to native int.
+  ///
+  /// \param TargetNode The call target.
+  /// \returns The call target in the form expected by \p emitCall.
+  IRNode *convertCallTarget(IRNode *TargetNode);
+
+  /// \brief Describe the result of an allocation helper call to the
+  /// optimizer.
+  ///
+  /// The helpers either return a new, zeroed object or throw, so the result
+  /// is never null, does not alias anything else, and may be dereferenced up
+  /// to the size of the object.
+  ///
+  /// \param Allocation  Call to the allocation helper.
+  /// \param NumElements Number of elements if the object is an array,
+  ///                    otherwise nullptr.
+  void setAllocationAttributes(llvm::CallSite Allocation,
+                               llvm::Value *NumElements);
+
+  /// \brief Inline the callees of the call sites noted while reading, and
+  /// report each decision to the EE.
+  void inlineCalls();
+
+  /// \brief Read a callee's MSIL into a new function and inline that function
+  /// at a call site.
+  ///
+  /// \param Call        The call to inline.
+  /// \param Callee      Method handle of the callee.
+  /// \param Reason[out] Why the callee was not inlined, if it was not.
+  /// \returns \p INLINE_PASS if the callee was inlined, otherwise the result
+  /// to report to the EE.
+  CorInfoInline inlineCall(llvm::CallInst *Call, CORINFO_METHOD_HANDLE Callee,
+                           const char *&Reason);
+
+  /// \brief Move the objects allocated by this method to the stack frame
+  /// when no reference to them can outlive the method.
+  ///
+  /// Runs once the callees have been inlined, so that constructors and other
+  /// small methods called on the objects no longer count as escapes.
+  void allocateObjectsOnStack();
+
+  /// \brief Add the block profile counters and counts noted while reading.
+  ///
+  /// Counters are incremented at the top of their blocks, after any PHIs or
+  /// EH pads. Counts become branch weights on conditional branches and
+  /// switches whose successors all have counts, and the count of the first
+  /// MSIL block becomes the function's entry count.
+  void applyBlockProfile();
+
+  /// \brief Check whether a reference to a new object may outlive the
+  /// method.
+  ///
+  /// References may be compared, used to load and store the object's fields,
+  /// and stored to locals that are only loaded and stored.
+  ///
+  /// \param Object   The call to the allocation helper.
+  /// \param Barriers [out] Write barrier calls that store into the object.
+  /// \returns true if a reference may escape.
+  bool doesObjectEscape(llvm::Instruction *Object,
+                        llvm::SmallVectorImpl<llvm::CallInst *> &Barriers);
+
   /// Zero initialize a stack allocation
   void zeroInit(llvm::Value *Var);
 
@@ -1493,6 +1636,27 @@ private:
   /// \param Size Size of the block.
   void zeroInitBlock(llvm::Value *Address, llvm::Value *Size);
 
+  /// \brief Copy or fill a small block with loads and stores rather than a
+  /// call to the MEMCPY or MEMSET helper.
+  ///
+  /// \param DestinationAddress Address of the block.
+  /// \param SourceAddress      Address to copy from, or nullptr to fill.
+  /// \param FillValue          Byte to fill with if \p SourceAddress is
+  ///                           nullptr.
+  /// \param ByteCount          Size of the block.
+  /// \param Alignment          Alignment of the addresses.
+  /// \param IsVolatile         true iff the operation is volatile.
+  /// \param AddressMayBeNull   true iff the addresses need null checks.
+  /// \param StructTy           Type of the struct being copied, if known.
+  ///                           Its GC references are copied as GC pointers.
+  /// \returns true if the code was generated, false if the helper has to be
+  /// called because the block is volatile or not of a small constant size.
+  bool genInlineBlockOp(llvm::Value *DestinationAddress,
+                        llvm::Value *SourceAddress, llvm::Value *FillValue,
+                        llvm::Value *ByteCount, ReaderAlignType Alignment,
+                        bool IsVolatile, bool AddressMayBeNull,
+                        llvm::StructType *StructTy = nullptr);
+
   /// Copy an instance of a struct from SourceAddress to DestinationAddress.
   /// Copying is done without write barriers.
   ///
@@ -1662,6 +1826,15 @@ private:
   IRNode *vectorNotEqual(IRNode *Vector1, IRNode *Vector2) override;
   IRNode *vectorMax(IRNode *Vector1, IRNode *Vector2, bool IsSigned) override;
   IRNode *vectorMin(IRNode *Vector1, IRNode *Vector2, bool IsSigned) override;
+  IRNode *vectorAndNot(IRNode *Vector1, IRNode *Vector2) override;
+  IRNode *vectorNarrow(IRNode *Vector1, IRNode *Vector2) override;
+  IRNode *vectorAllEqual(IRNode *Vector1, IRNode *Vector2,
+                         bool IsNotEqual) override;
+  IRNode *vectorCompare(ReaderSIMDIntrinsic OperationCode, IRNode *Vector1,
+                        IRNode *Vector2, bool IsSigned,
+                        CORINFO_CLASS_HANDLE ResultClass) override;
+  IRNode *vectorDot(IRNode *Vector1, IRNode *Vector2,
+                    CorInfoType ResType) override;
 
   llvm::Type *getVectorIntType(unsigned VectorByteSize);
 
@@ -1673,6 +1846,28 @@ private:
                         unsigned VectorByteSize) override;
   IRNode *vectorAbs(IRNode *Vector) override;
   IRNode *vectorSqrt(IRNode *Vector) override;
+  IRNode *vectorNeg(IRNode *Vector) override;
+  IRNode *vectorNot(IRNode *Vector) override;
+  IRNode *vectorConvert(IRNode *Vector, bool IsSigned,
+                        CORINFO_CLASS_HANDLE ResultClass) override;
+  IRNode *vectorConditionalSelect(IRNode *Mask, IRNode *Vector1,
+                                  IRNode *Vector2) override;
+  IRNode *vectorWiden(IRNode *Vector, IRNode *LowPointer, IRNode *HighPointer,
+                      bool IsSigned) override;
+
+  /// \brief Get the address of a vector's worth of elements of \p Array,
+  /// starting at \p Index.
+  ///
+  /// Checks that the array is not null and that all the elements are in
+  /// range, so the vector can be loaded in one access.
+  ///
+  /// \param Array    The array.
+  /// \param Index    Index of the first element.
+  /// \param VectorTy Type of the vector to access.
+  /// \returns Address of the first element, typed as a pointer to
+  /// \p VectorTy.
+  IRNode *vectorArrayAddress(IRNode *Array, IRNode *Index,
+                             llvm::VectorType *VectorTy);
 
   bool isVectorType(IRNode *Arg) override;
 
@@ -1696,6 +1891,8 @@ private:
 
   IRNode *vectorGetItem(IRNode *VectorPointer, IRNode *Index,
                         CorInfoType ResType) override;
+  IRNode *vectorCopyTo(IRNode *VectorPointer, IRNode *Array,
+                       IRNode *Index) override;
 
   /// Get information corresponding to the handle.
   ///
@@ -1820,6 +2017,33 @@ private:
   /// MSIL array type that has that element type.
   std::map<llvm::Type *, llvm::PointerType *> ElementToArrayTypeMap;
 
+  /// \brief Direct calls whose callees may be inlined, along with the
+  /// callee's method handle.
+  llvm::SmallVector<std::pair<llvm::WeakVH, CORINFO_METHOD_HANDLE>, 4>
+      InlineCandidates;
+
+  /// \brief Blocks to instrument for the block profile, along with the
+  /// counter each one increments.
+  std::vector<std::pair<llvm::WeakVH, uint32_t *>> IBCCounters;
+
+  /// \brief Blocks with a count in the block profile, along with the count.
+  std::vector<std::pair<llvm::WeakVH, uint32_t>> IBCCounts;
+
+  /// \brief Objects allocated by this method, along with their exact class.
+  llvm::ValueMap<const llvm::Value *, CORINFO_CLASS_HANDLE> ExactClassMap;
+
+  static const uint32_t MaxInlineILSize = 32;   ///< Largest callee, in bytes
+                                                ///< of MSIL, to inline.
+  static const uint32_t MaxInlinesPerMethod = 32; ///< Limit on the number of
+                                                  ///< call sites inlined into
+                                                  ///< one method.
+  static const uint32_t MaxStackObjectSize = 256; ///< Largest object, in
+                                                  ///< bytes, to allocate on
+                                                  ///< the stack.
+  static const uint32_t MaxInlineBlockSize = 64; ///< Largest block, in
+                                                 ///< bytes, to copy or fill
+                                                 ///< without a helper call.
+
   static const uint32_t ArrayIntrinMaxRank = 3; ///< This constant determines
                                                 ///< the maximum rank of an
                                                 ///< array access that we will
@@ -22,11 +22,23 @@
 #include "llvm/Object/StackMapParser.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/WinEHFuncInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCDisassembler.h"
+#include "llvm/MC/MCInst.h"
+#include "llvm/MC/MCInstrInfo.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOpcodes.h"
 #include "llvm/Target/TargetSubtargetInfo.h"
 #include "llvm/Target/TargetFrameLowering.h"
 
 using namespace llvm;
 
+#if defined(BIGENDIAN)
+typedef StackMapV1Parser<support::big> StackMapParserType;
+#else
+typedef StackMapV1Parser<support::little> StackMapParserType;
+#endif
+
 //-------------------------------GcInfo------------------------------------------
 
 bool GcInfo::isGcPointer(const Type *Type) {
@@ -133,6 +145,66 @@ void GcInfo::getGcPointers(StructType *StructTy, const DataLayout &DataLayout,
   }
 }
 
+ICorDebugInfo::RegNum GcInfo::mapDwarfRegisterToRegNum(uint16_t DwarfRegNum) {
+  ICorDebugInfo::RegNum Register = ICorDebugInfo::REGNUM_COUNT;
+#if defined(_TARGET_AMD64_)
+  switch (DwarfRegNum) {
+  case DW_RAX:
+    Register = ICorDebugInfo::REGNUM_RAX;
+    break;
+  case DW_RDX:
+    Register = ICorDebugInfo::REGNUM_RDX;
+    break;
+  case DW_RCX:
+    Register = ICorDebugInfo::REGNUM_RCX;
+    break;
+  case DW_RBX:
+    Register = ICorDebugInfo::REGNUM_RBX;
+    break;
+  case DW_RSI:
+    Register = ICorDebugInfo::REGNUM_RSI;
+    break;
+  case DW_RDI:
+    Register = ICorDebugInfo::REGNUM_RDI;
+    break;
+  case DW_RBP:
+    Register = ICorDebugInfo::REGNUM_RBP;
+    break;
+  case DW_RSP:
+    Register = ICorDebugInfo::REGNUM_RSP;
+    break;
+  case DW_R8:
+    Register = ICorDebugInfo::REGNUM_R8;
+    break;
+  case DW_R9:
+    Register = ICorDebugInfo::REGNUM_R9;
+    break;
+  case DW_R10:
+    Register = ICorDebugInfo::REGNUM_R10;
+    break;
+  case DW_R11:
+    Register = ICorDebugInfo::REGNUM_R11;
+    break;
+  case DW_R12:
+    Register = ICorDebugInfo::REGNUM_R12;
+    break;
+  case DW_R13:
+    Register = ICorDebugInfo::REGNUM_R13;
+    break;
+  case DW_R14:
+    Register = ICorDebugInfo::REGNUM_R14;
+    break;
+  case DW_R15:
+    Register = ICorDebugInfo::REGNUM_R15;
+    break;
+  default:
+    Register = ICorDebugInfo::REGNUM_COUNT;
+    break;
+  }
+#endif // defined(_TARGET_AMD64_)
+  return Register;
+}
+
 GcFuncInfo *GcInfo::newGcInfo(const llvm::Function *F) {
   assert(getGcInfo(F) == nullptr && "Duplicate GcInfo");
   GcFuncInfo *GcFInfo = new GcFuncInfo(F);
@@ -161,6 +233,7 @@ GcFuncInfo::GcFuncInfo(const llvm::Function *F) {
   GenericsContextParamType = GENERIC_CONTEXTPARAM_NONE;
   PSPSymOffset = 0;
   HasFunclets = false;
+  NumSafepoints = 0;
 }
 
 void GcFuncInfo::recordAlloca(const AllocaInst *Alloca) {
@@ -381,6 +454,16 @@ bool GcInfoRecorder::runOnMachineFunction(MachineFunction &MF) {
     }
   }
 
+  // Each statepoint produces one record in the StackMap section.
+  GcFuncInfo->NumSafepoints = 0;
+  for (const MachineBasicBlock &Block : MF) {
+    for (const MachineInstr &Instr : Block) {
+      if (Instr.getOpcode() == TargetOpcode::STATEPOINT) {
+        GcFuncInfo->NumSafepoints++;
+      }
+    }
+  }
+
   // Unlike the other offsets reported to the GC, the PSPSym offset is relative
   // to Initial-SP (i.e. the value of the stack pointer just after this
   // method's prolog), NOT Caller-SP.
@@ -403,15 +486,16 @@ bool GcInfoRecorder::runOnMachineFunction(MachineFunction &MF) {
 //-------------------------------GcInfoEmitter-----------------------------------
 
 GcInfoEmitter::GcInfoEmitter(LLILCJitContext *JitCtx, uint8_t *StackMapData,
-                             GcInfoAllocator *Allocator)
+                             uint8_t *CodeBlock, GcInfoAllocator *Allocator)
 
-    : JitContext(JitCtx), LLVMStackMapData(StackMapData),
+    : JitContext(JitCtx), LLVMStackMapData(StackMapData), CodeBlock(CodeBlock),
       Encoder(JitContext->JitInfo, JitContext->MethodInfo, Allocator),
-      SlotMap(), FirstTrackedSlot(0), NumTrackedSlots(0) {
+      SlotMap(), RegisterSlotMap(), FirstTrackedSlot(0), NumTrackedSlots(0) {
 #if !defined(NDEBUG)
   this->EmitLogs = JitContext->Options->LogGcInfo;
 #endif // !NDEBUG
 #if defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
+  this->NumCallSites = 0;
   this->CallSites = nullptr;
   this->CallSiteSizes = nullptr;
 #endif // defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
@@ -479,22 +563,61 @@ void GcInfoEmitter::encodeHeader(const GcFuncInfo *GcFuncInfo) {
 #endif // defined(FIXED_STACK_PARAMETER_SCRATCH_AREA)
 }
 
-void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
+void GcInfoEmitter::mapSafepoints() {
   ArrayRef<uint8_t> StackMapContentsArray(LLVMStackMapData,
                                           JitContext->StackMapSize);
+  StackMapParserType StackMapParser(StackMapContentsArray);
 
-#if defined(BIGENDIAN)
-  typedef StackMapV1Parser<support::big> StackMapParserType;
-#else
-  typedef StackMapV1Parser<support::little> StackMapParserType;
-#endif
+  // StackMap v1 does not say which records belong to which function.
+  // Functions appear in the stack map in the order they were emitted,
+  // i.e. module order, if they have any safepoints; and their records
+  // follow one function after another. GcInfoRecorder counted each
+  // function's safepoints, so the records can be split up accordingly.
+  uint32_t FunctionIndex = 0;
+  uint32_t RecordIndex = 0;
+  for (const Function &F : *JitContext->CurrentModule) {
+    if (!needsGCInfo(&F)) {
+      continue;
+    }
+
+    const GcFuncInfo *GcFuncInfo = JitContext->GcInfo->getGcInfo(&F);
+    if ((GcFuncInfo == nullptr) || (GcFuncInfo->NumSafepoints == 0)) {
+      continue;
+    }
+
+    assert(FunctionIndex < StackMapParser.getNumFunctions() &&
+           "Function missing from the StackMap");
+    uint64_t FunctionAddress =
+        StackMapParser.getFunction(FunctionIndex).getFunctionAddress();
+    assert((CodeBlock != nullptr) && (FunctionAddress >= (uint64_t)CodeBlock) &&
+           "Function outside the code block");
+
+    FunctionSafepoints &Safepoints = SafepointMap[&F];
+    Safepoints.CodeOffset = FunctionAddress - (uint64_t)CodeBlock;
+    Safepoints.FirstRecord = RecordIndex;
+    Safepoints.NumRecords = GcFuncInfo->NumSafepoints;
+
+    FunctionIndex++;
+    RecordIndex += GcFuncInfo->NumSafepoints;
+  }
+
+  assert(FunctionIndex == StackMapParser.getNumFunctions() &&
+         "StackMap functions do not match the module");
+  assert(RecordIndex == StackMapParser.getNumRecords() &&
+         "StackMap records do not match the recorded safepoints");
+}
+
+void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
+  ArrayRef<uint8_t> StackMapContentsArray(LLVMStackMapData,
+                                          JitContext->StackMapSize);
   StackMapParserType StackMapParser(StackMapContentsArray);
 
-  // TODO: Once StackMap v2 is implemented, remove this assertion about
-  // one function per module, and emit the GcInfo for the records
-  // corresponding to the Function 'F'
-  assert(StackMapParser.getNumFunctions() == 1 &&
-         "Expect only one function with GcInfo in the module");
+  // Only look at the records for the Function being encoded.
+  FunctionSafepoints Safepoints = {0, 0, 0};
+  auto SafepointIterator = SafepointMap.find(GcFuncInfo->Function);
+  if (SafepointIterator != SafepointMap.end()) {
+    Safepoints = SafepointIterator->second;
+  }
 
 // Loop over LLVM StackMap records to:
 // 1) Note CallSites (safepoints)
@@ -502,19 +625,13 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
 // 3) Record liveness (birth/death) of slots per call-site.
 
 #if defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
-  NumCallSites = StackMapParser.getNumRecords();
+  delete[] CallSites;
+  delete[] CallSiteSizes;
+  NumCallSites = Safepoints.NumRecords;
   CallSites = new unsigned[NumCallSites];
   CallSiteSizes = new BYTE[NumCallSites];
 #endif // defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
 
-  // TODO: Determine call-site-size accurately
-  // https://github.com/Microsoft/llvm/issues/56
-  // Call-site size is not available in LLVM's StackMap v1, so just make up
-  // a value for now. The Call-instruction generated by LLILC on X86/X64
-  // is typically Call [rax], which has a two-byte encoding.
-  //
-  // Any size > 0 can be reported as CallSizeSize, see explanation below.
-  //
   // CoreCLR's API expects that we report:
   // (a) the offset at the beginning of the Call instruction, and
   // (b) size of the call instruction.
@@ -522,14 +639,9 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
   // LLVM's stackMap currently only reports:
   // (c) the offset at the safepoint after the call instruction (= a+b)
   //
-  // When not in a fully-intrruptible block, CoreCLR only
-  // uses the value of (a+b) to determine the end of the call
-  // instruction. Therefore, we simply report a = c-2 and b = 2 for now.
-  //
-  // Once call-size size is available in LLVM StackMap v2, we can remove this
-  // implementation specific workaround.
-
-  const uint8_t CallSiteSize = 2;
+  // So, recover the size of each call instruction by decoding the
+  // emitted code.
+  decodeCallSites();
 
   // LLVM StackMap records all live-pointers per Safepoint, whereas
   // CoreCLR's GCTables record pointer birth/deaths per Safepoint.
@@ -543,8 +655,23 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
   SmallBitVector OldLiveSet(LiveBitSetSize);
   SmallBitVector NewLiveSet(LiveBitSetSize);
 
-  size_t RecordIndex = 0;
-  for (const auto &R : StackMapParser.records()) {
+  // Make room in the live sets for a newly allocated slot.
+  auto growLiveSets = [&]() {
+    if (getNumSlots() > LiveBitSetSize) {
+      LiveBitSetSize += LiveBitSetSize;
+
+      assert(LiveBitSetSize > OldLiveSet.size() &&
+             "Overflow -- Too many live pointers");
+
+      OldLiveSet.resize(LiveBitSetSize);
+      NewLiveSet.resize(LiveBitSetSize);
+    }
+  };
+
+  for (size_t RecordIndex = 0; RecordIndex < Safepoints.NumRecords;
+       RecordIndex++) {
+    const auto R =
+        StackMapParser.getRecord(Safepoints.FirstRecord + RecordIndex);
 
     // InstructionOffset - CallSiteSize:
     //   to report the start of the Instruction
@@ -553,7 +680,12 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
     // instruction, whereas the CoreCLR API expects that we report
     // the start of the Call instruction.
 
-    unsigned InstructionOffset = R.getInstructionOffset() - CallSiteSize;
+    // The EE expects offsets relative to the method's code block, whereas
+    // the StackMap's are relative to the Function's start.
+    const unsigned ReturnOffset =
+        Safepoints.CodeOffset + R.getInstructionOffset();
+    const uint8_t CallSiteSize = getCallSiteSize(ReturnOffset);
+    unsigned InstructionOffset = ReturnOffset - CallSiteSize;
 
 #if defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
     CallSites[RecordIndex] = InstructionOffset;
@@ -573,12 +705,32 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
       case StackMapParserType::LocationKind::ConstantIndex:
         continue;
 
-      case StackMapParserType::LocationKind::Register:
-        // TODO: Report Live - GC values in Registers
-        // https://github.com/dotnet/llilc/issues/474
-        // Live gc-pointers are currently spilled to the stack at Safepoints.
-        assert(false && "GC-Pointer Live in Register");
+      case StackMapParserType::LocationKind::Register: {
+        // Statepoint lowering may keep a live gc-pointer in a callee-saved
+        // register across the call; the runtime recovers its value by
+        // unwinding the callee.
+        ICorDebugInfo::RegNum RegNum =
+            GcInfo::mapDwarfRegisterToRegNum(Loc.getDwarfRegNum());
+        assert(RegNum != ICorDebugInfo::REGNUM_COUNT &&
+               "Unexpected GC-Pointer Register");
+        assert(RegNum != ICorDebugInfo::REGNUM_RSP &&
+               "Stack Pointer cannot hold a GC-Pointer");
+
+        GcSlotId SlotID;
+        DenseMap<uint32_t, GcSlotId>::const_iterator ExistingSlot =
+            RegisterSlotMap.find(RegNum);
+        if (ExistingSlot == RegisterSlotMap.end()) {
+          SlotID = getTrackedRegisterSlot(RegNum);
+          growLiveSets();
+        } else {
+          SlotID = ExistingSlot->second;
+        }
+
+        assert(isTrackedSlot(SlotID) &&
+               "Tracked and Untracked slots must be disjoint");
+        NewLiveSet[SlotID] = true;
         break;
+      }
 
       case StackMapParserType::LocationKind::Indirect: {
         // __LLVM_Stackmap reports the liveness of pointers wrt SP even for
@@ -592,16 +744,7 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
             SlotMap.find(Offset);
         if (ExistingSlot == SlotMap.end()) {
           SlotID = getTrackedSlot(Offset);
-
-          if (SlotMap.size() > LiveBitSetSize) {
-            LiveBitSetSize += LiveBitSetSize;
-
-            assert(LiveBitSetSize > OldLiveSet.size() &&
-                   "Overflow -- Too many live pointers");
-
-            OldLiveSet.resize(LiveBitSetSize);
-            NewLiveSet.resize(LiveBitSetSize);
-          }
+          growLiveSets();
         } else {
           SlotID = ExistingSlot->second;
         }
@@ -618,7 +761,7 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
       }
     }
 
-    for (GcSlotId SlotID = 0; SlotID < SlotMap.size(); SlotID++) {
+    for (GcSlotId SlotID = 0; SlotID < getNumSlots(); SlotID++) {
       if (!OldLiveSet[SlotID] && NewLiveSet[SlotID]) {
 #if !defined(NDEBUG)
         if (EmitLogs) {
@@ -639,8 +782,6 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
       NewLiveSet[SlotID] = false;
     }
 
-    RecordIndex++;
-
 #if !defined(NDEBUG)
     if (EmitLogs) {
       LiveStream << "\n";
@@ -649,6 +790,59 @@ void GcInfoEmitter::encodeTrackedPointers(const GcFuncInfo *GcFuncInfo) {
   }
 }
 
+void GcInfoEmitter::decodeCallSites() {
+  if (!CallSizeMap.empty() || (CodeBlock == nullptr)) {
+    return;
+  }
+
+  const TargetMachine *TM = JitContext->TM;
+  const MCSubtargetInfo *STI = TM->getMCSubtargetInfo();
+  const MCInstrInfo *MII = TM->getMCInstrInfo();
+  MCContext Context(TM->getMCAsmInfo(), TM->getMCRegisterInfo(), nullptr);
+  std::unique_ptr<MCDisassembler> Disassembler(
+      TM->getTarget().createMCDisassembler(*STI, Context));
+  if (!Disassembler) {
+    return;
+  }
+
+  // Sweep the code linearly. LLVM does not place data in the code section,
+  // and padding between functions is made of (decodable) nops and traps.
+  ArrayRef<uint8_t> Code(CodeBlock, JitContext->HotCodeSize);
+  uint64_t Offset = 0;
+  while (Offset < Code.size()) {
+    MCInst Instruction;
+    uint64_t Size = 0;
+    MCDisassembler::DecodeStatus Status = Disassembler->getInstruction(
+        Instruction, Size, Code.slice(Offset), Offset, nulls(), nulls());
+    if ((Status != MCDisassembler::Success) || (Size == 0)) {
+      // Lost track of instruction boundaries; fall back to the default size
+      // for every call site rather than risk reporting a wrong one.
+      CallSizeMap.clear();
+      return;
+    }
+
+    Offset += Size;
+    if (MII->get(Instruction.getOpcode()).isCall()) {
+      CallSizeMap[Offset] = static_cast<uint8_t>(Size);
+    }
+  }
+}
+
+uint8_t GcInfoEmitter::getCallSiteSize(uint32_t ReturnOffset) {
+  DenseMap<uint32_t, uint8_t>::const_iterator Call =
+      CallSizeMap.find(ReturnOffset);
+  if (Call != CallSizeMap.end()) {
+    return Call->second;
+  }
+
+  // When not in a fully-interruptible block, CoreCLR only uses the end of
+  // the call instruction (a+b), so any size > 0 is acceptable. The call
+  // generated by LLILC on X86/X64 is typically Call [rax], which has a
+  // two-byte encoding.
+  const uint8_t DefaultCallSiteSize = 2;
+  return DefaultCallSiteSize;
+}
+
 void GcInfoEmitter::encodeUntrackedPointers(const GcFuncInfo *GcFuncInfo) {
   for (auto AllocaIterator : GcFuncInfo->AllocaMap) {
     const AllocaInfo &AllocaInfo = AllocaIterator.second;
@@ -724,10 +918,11 @@ void GcInfoEmitter::finalizeEncoding() {
 
 #if defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
   // Encode Call-sites
-  assert(CallSiteSizes != nullptr);
-  assert(CallSites != nullptr);
-  assert(NumCallSites > 0);
-  Encoder.DefineCallSites(CallSites, CallSiteSizes, NumCallSites);
+  if (NumCallSites > 0) {
+    assert(CallSiteSizes != nullptr);
+    assert(CallSites != nullptr);
+    Encoder.DefineCallSites(CallSites, CallSiteSizes, NumCallSites);
+  }
 #endif // defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
 }
 
@@ -745,8 +940,8 @@ void GcInfoEmitter::emitEncoding() {
 
 GcInfoEmitter::~GcInfoEmitter() {
 #if defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
-  delete CallSites;
-  delete CallSiteSizes;
+  delete[] CallSites;
+  delete[] CallSiteSizes;
 #endif // defined(PARTIALLY_INTERRUPTIBLE_GC_SUPPORTED)
 }
 
@@ -768,12 +963,27 @@ void GcInfoEmitter::emitGCInfo(const GcFuncInfo *GcFuncInfo) {
 }
 
 void GcInfoEmitter::emitGCInfo() {
+  if (LLVMStackMapData != nullptr) {
+    mapSafepoints();
+  }
+
+  // CoreCLR takes a single GcInfo per method, covering all of its code,
+  // and funclets are not split out into Functions of their own. So there
+  // is one GC Function to report. The encoder and the slot maps describe
+  // that one Function's frame, and are not reset between Functions.
+  const GcFuncInfo *MethodGcInfo = nullptr;
   for (auto GcInfoIterator : JitContext->GcInfo->GcInfoMap) {
     GcFuncInfo *GcFuncInfo = GcInfoIterator->second;
     if (needsGCInfo(GcFuncInfo->Function)) {
-      emitGCInfo(GcFuncInfo);
+      assert((MethodGcInfo == nullptr) &&
+             "Expect only one function with GcInfo in the module");
+      MethodGcInfo = GcFuncInfo;
     }
   }
+
+  if (MethodGcInfo != nullptr) {
+    emitGCInfo(MethodGcInfo);
+  }
 }
 
 bool GcInfoEmitter::needsGCInfo(const Function *F) {
@@ -798,7 +1008,7 @@ GcSlotId GcInfoEmitter::getSlot(const int32_t Offset, const GcSlotFlags Flags) {
   GcSlotId SlotID = Encoder.GetStackSlotId(Offset, Flags, GC_SP_REL);
   SlotMap[Offset] = SlotID;
 
-  assert(SlotID == (SlotMap.size() - 1) && "SlotIDs dis-contiguous");
+  assert(SlotID == (getNumSlots() - 1) && "SlotIDs dis-contiguous");
 
 #if !defined(NDEBUG)
   if (EmitLogs) {
@@ -829,6 +1039,33 @@ GcSlotId GcInfoEmitter::getTrackedSlot(const int32_t Offset) {
   return SlotID;
 }
 
+GcSlotId GcInfoEmitter::getTrackedRegisterSlot(const uint32_t RegNum) {
+  assert(RegisterSlotMap.find(RegNum) == RegisterSlotMap.end() &&
+         "Slot already allocated");
+
+  // Conservatively describe register slots as containing interior pointers,
+  // just like tracked stack slots.
+  const GcSlotFlags ManagedPointerFlags = (GcSlotFlags)GC_SLOT_INTERIOR;
+  GcSlotId SlotID = Encoder.GetRegisterSlotId(RegNum, ManagedPointerFlags);
+  RegisterSlotMap[RegNum] = SlotID;
+
+  assert(SlotID == (getNumSlots() - 1) && "SlotIDs dis-contiguous");
+
+#if !defined(NDEBUG)
+  if (EmitLogs) {
+    SlotStream << "    [" << SlotID << "]: "
+               << "reg" << RegNum << " (M)\n";
+  }
+#endif // !NDEBUG
+
+  NumTrackedSlots++;
+  if (NumTrackedSlots == 1) {
+    FirstTrackedSlot = SlotID;
+  }
+
+  return SlotID;
+}
+
 GcSlotId GcInfoEmitter::getUntrackedSlot(const int32_t Offset, bool IsPinned,
                                          bool IsObjectRef) {
   GcSlotFlags UntrackedFlags = (GcSlotFlags)GC_SLOT_UNTRACKED;
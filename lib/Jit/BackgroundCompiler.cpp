@@ -0,0 +1,364 @@
+//===---- lib/Jit/BackgroundCompiler.cpp ------------------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implementation of the background recompilation thread pool.
+///
+//===----------------------------------------------------------------------===//
+
+#include "earlyincludes.h"
+#include "jitpch.h"
+#include "LLILCJit.h"
+#include "BackgroundCompiler.h"
+#include "EEObjectCache.h"
+#include "GcInfo.h"
+#include "compiler.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static double getWallTime() {
+  return TimeRecord::getCurrentTime(true).getWallTime();
+}
+
+BackgroundCompiler::BackgroundCompiler(unsigned NumThreads)
+    : IsShuttingDown(false), FreeCounters(nullptr), NumFreeCounters(0),
+      NumRegistered(0), NumDropped(0), NumQueued(0), NumPublished(0),
+      NumFailed(0), MaxObservedDepth(0), TotalPublishTime(0),
+      MaxPublishTime(0) {
+  for (unsigned I = 0; I < NumThreads; ++I) {
+    Workers.emplace_back(&BackgroundCompiler::runWorker, this);
+  }
+}
+
+BackgroundCompiler::~BackgroundCompiler() { shutdown(); }
+
+void BackgroundCompiler::shutdown() {
+  std::vector<std::thread> Joining;
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    IsShuttingDown = true;
+    Queue.clear();
+    Pending.clear();
+    Joining.swap(Workers);
+  }
+  HasWork.notify_all();
+  for (std::thread &Worker : Joining) {
+    Worker.join();
+  }
+}
+
+uint32_t *BackgroundCompiler::enqueue(LLILCJitContext &Context,
+                                      StringRef CacheDirectory, StringRef Key,
+                                      bool ContainsUnmanagedCall) {
+  // Don't bother copying the method if there is no room for it.
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (IsShuttingDown) {
+      return nullptr;
+    }
+    if (Pending.size() >= MaxPendingRequests) {
+      ++NumDropped;
+      return nullptr;
+    }
+  }
+
+  std::unique_ptr<BackgroundRequest> Request(new BackgroundRequest());
+  Request->MethodName = Context.MethodName;
+  Request->Flags = Context.Flags;
+  Request->Options = *Context.Options;
+  Request->ContainsUnmanagedCall = ContainsUnmanagedCall;
+  Request->CacheDirectory = CacheDirectory;
+  Request->Key = Key;
+
+  // The worker compiles in its own LLVMContext, so the module travels as
+  // bitcode. Bitcode keeps instruction order, so the reader's allocas can be
+  // found again by their position.
+  raw_svector_ostream BitcodeStream(Request->Bitcode);
+  WriteBitcodeToFile(Context.CurrentModule, BitcodeStream);
+
+  for (Function &F : *Context.CurrentModule) {
+    if (F.isDeclaration() || !GcInfo::isGcFunction(&F)) {
+      continue;
+    }
+    GcFuncInfo *GcFuncInfo = Context.GcInfo->getGcInfo(&F);
+    if (GcFuncInfo == nullptr) {
+      continue;
+    }
+
+    BackgroundRequest::FunctionRecord Frame;
+    Frame.Name = F.getName();
+    Frame.GsCkValidRangeStart = GcFuncInfo->GsCkValidRangeStart;
+    Frame.GsCkValidRangeEnd = GcFuncInfo->GsCkValidRangeEnd;
+    Frame.ParamType = GcFuncInfo->GenericsContextParamType;
+    uint32_t AllocaIndex = 0;
+    for (Instruction &I : instructions(F)) {
+      AllocaInst *Alloca = dyn_cast<AllocaInst>(&I);
+      if (Alloca == nullptr) {
+        continue;
+      }
+      if (GcFuncInfo->hasRecord(Alloca)) {
+        BackgroundRequest::SlotRecord Slot;
+        Slot.AllocaIndex = AllocaIndex;
+        Slot.Info = GcFuncInfo->AllocaMap[Alloca];
+        Slot.Info.Offset = GcInfo::InvalidPointerOffset;
+        Frame.Slots.push_back(Slot);
+      }
+      ++AllocaIndex;
+    }
+    Request->Frames.push_back(std::move(Frame));
+  }
+
+  uint32_t *Counter;
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (IsShuttingDown) {
+      return nullptr;
+    }
+    if (Pending.size() >= MaxPendingRequests) {
+      ++NumDropped;
+      return nullptr;
+    }
+    Counter = allocateCounter();
+    PendingRequest Entry;
+    Entry.Request = std::move(Request);
+    Entry.Counter = Counter;
+    Pending.push_back(std::move(Entry));
+    ++NumRegistered;
+  }
+
+  if (Context.Options->DumpLevel == ::DumpLevel::VERBOSE) {
+    dbgs() << "INFO:  registered " << Context.MethodName
+           << " for background compilation\n";
+  }
+  return Counter;
+}
+
+void BackgroundCompiler::insertCallCounter(Module &M, uint32_t *Counter) {
+  for (Function &F : M) {
+    if (F.isDeclaration() || !GcInfo::isGcFunction(&F)) {
+      continue;
+    }
+
+    // The count only needs to be roughly right, so concurrent callers may
+    // lose increments. It is volatile so that nothing after this point
+    // removes it. Going after the entry block's allocas keeps them together.
+    IRBuilder<> Builder(F.getEntryBlock().getTerminator());
+    Type *CounterTy = Builder.getInt32Ty();
+    Constant *Address = ConstantExpr::getIntToPtr(
+        Builder.getInt64((uint64_t)Counter), CounterTy->getPointerTo());
+    LoadInst *Count = Builder.CreateLoad(Address, true);
+    Builder.CreateStore(Builder.CreateAdd(Count, Builder.getInt32(1)), Address,
+                        true);
+  }
+}
+
+uint32_t *BackgroundCompiler::allocateCounter() {
+  static const unsigned CountersPerChunk = 1024;
+  if (NumFreeCounters == 0) {
+    FreeCounters = new uint32_t[CountersPerChunk]();
+    NumFreeCounters = CountersPerChunk;
+  }
+  --NumFreeCounters;
+  return FreeCounters++;
+}
+
+void BackgroundCompiler::queueHotRequests() {
+  auto IsHot = [](const PendingRequest &Entry) {
+    return *(volatile uint32_t *)Entry.Counter >= HotCallCount;
+  };
+  auto Next = Pending.begin();
+  for (auto I = Pending.begin(), E = Pending.end(); I != E; ++I) {
+    if (Queue.size() < MaxQueueDepth && IsHot(*I)) {
+      I->Request->EnqueueTime = getWallTime();
+      Queue.push_back(std::move(I->Request));
+      ++NumQueued;
+      continue;
+    }
+    if (Next != I) {
+      *Next = std::move(*I);
+    }
+    ++Next;
+  }
+  Pending.erase(Next, Pending.end());
+  if (Queue.size() > MaxObservedDepth) {
+    MaxObservedDepth = Queue.size();
+  }
+}
+
+void BackgroundCompiler::runWorker() {
+  while (true) {
+    std::unique_ptr<BackgroundRequest> Request;
+    {
+      // The cheap code doesn't signal when it gets hot, so look at the
+      // counts every so often.
+      std::unique_lock<std::mutex> Guard(Lock);
+      while (!IsShuttingDown) {
+        queueHotRequests();
+        if (!Queue.empty()) {
+          break;
+        }
+        HasWork.wait_for(Guard, std::chrono::milliseconds(PollInterval));
+      }
+      if (IsShuttingDown) {
+        return;
+      }
+      Request = std::move(Queue.front());
+      Queue.pop_front();
+    }
+
+    bool IsPublished = compile(*Request);
+    double PublishTime = getWallTime() - Request->EnqueueTime;
+
+    {
+      std::lock_guard<std::mutex> Guard(Lock);
+      if (IsPublished) {
+        ++NumPublished;
+        TotalPublishTime += PublishTime;
+        if (PublishTime > MaxPublishTime) {
+          MaxPublishTime = PublishTime;
+        }
+      } else {
+        ++NumFailed;
+      }
+    }
+
+    if (Request->Options.DumpLevel >= ::DumpLevel::SUMMARY) {
+      dbgs() << "INFO:  background compilation of " << Request->MethodName
+             << (IsPublished ? " published after " : " failed after ")
+             << format("%.3f", PublishTime * 1000) << " ms\n";
+      printStatistics(dbgs());
+    }
+  }
+}
+
+bool BackgroundCompiler::compile(BackgroundRequest &Request) {
+  LLILCJit *Jit = LLILCJit::TheJit;
+  LLILCJitPerThreadState *PerThreadState = Jit->getPerThreadState();
+
+  // Set up a context for the request. There is no EE to talk to, so only
+  // the parts used by the optimizer and codegen are filled in.
+  LLILCJitContext Context(PerThreadState);
+  Context.JitInfo = nullptr;
+  Context.JitHost = nullptr;
+  Context.MethodInfo = nullptr;
+  Context.Flags = Request.Flags;
+  Context.MethodName = Request.MethodName;
+  Context.LLVMContext = &PerThreadState->LLVMContext;
+  Context.CurrentModule = nullptr;
+  Context.TM = nullptr;
+  Context.TheABIInfo = nullptr;
+  Context.Options = &Request.Options;
+  Context.GcInfo = nullptr;
+
+  std::string ErrStr;
+  TargetMachine *TM = PerThreadState->getTargetMachine(
+      CodeGenOpt::Level::Default, CodeModel::JITDefault, false,
+      Request.Options.TargetCPU, Request.Options.TargetFeatures, ErrStr);
+  if (TM == nullptr) {
+    return false;
+  }
+  Context.TM = TM;
+
+  MemoryBufferRef Bitcode(
+      StringRef(Request.Bitcode.data(), Request.Bitcode.size()),
+      Request.MethodName);
+  ErrorOr<std::unique_ptr<Module>> ModuleOrError =
+      parseBitcodeFile(Bitcode, *Context.LLVMContext);
+  if (!ModuleOrError) {
+    return false;
+  }
+  std::unique_ptr<Module> M = std::move(ModuleOrError.get());
+  Context.CurrentModule = M.get();
+
+  // Restore the frame information the reader recorded.
+  GcInfo FrameGcInfo;
+  Context.GcInfo = &FrameGcInfo;
+  bool IsOk = true;
+  for (const BackgroundRequest::FunctionRecord &Frame : Request.Frames) {
+    Function *F = M->getFunction(Frame.Name);
+    if (F == nullptr) {
+      IsOk = false;
+      break;
+    }
+    GcFuncInfo *GcFuncInfo = FrameGcInfo.newGcInfo(F);
+    GcFuncInfo->GsCkValidRangeStart = Frame.GsCkValidRangeStart;
+    GcFuncInfo->GsCkValidRangeEnd = Frame.GsCkValidRangeEnd;
+    GcFuncInfo->GenericsContextParamType = Frame.ParamType;
+
+    SmallVector<const AllocaInst *, 16> Allocas;
+    for (Instruction &I : instructions(*F)) {
+      if (AllocaInst *Alloca = dyn_cast<AllocaInst>(&I)) {
+        Allocas.push_back(Alloca);
+      }
+    }
+    for (const BackgroundRequest::SlotRecord &Slot : Frame.Slots) {
+      if (Slot.AllocaIndex >= Allocas.size()) {
+        IsOk = false;
+        break;
+      }
+      GcFuncInfo->AllocaMap[Allocas[Slot.AllocaIndex]] = Slot.Info;
+    }
+    if (!IsOk) {
+      break;
+    }
+  }
+
+  bool IsPublished = false;
+  if (IsOk) {
+    // Number the slots before any pass runs, as the requesting thread did
+    // when it looked up the key.
+    EEObjectCache Cache(&Context, Request.CacheDirectory);
+    Cache.prepareStore(*M, Request.Key);
+
+    if (Request.Options.DoIROptimization) {
+      Jit->optimizeMethod(&Context);
+    }
+    Jit->placeSafepoints(&Context, Request.ContainsUnmanagedCall);
+
+    object::OwningBinary<object::ObjectFile> Object =
+        orc::LLILCCompiler(*TM)(*M);
+    if (Object.getBinary() != nullptr) {
+      Cache.notifyObjectCompiled(M.get(),
+                                 Object.getBinary()->getMemoryBufferRef());
+      IsPublished = Cache.store();
+    }
+  }
+
+  for (auto GcInfoIterator : FrameGcInfo.GcInfoMap) {
+    delete GcInfoIterator.second;
+  }
+  FrameGcInfo.GcInfoMap.clear();
+  Context.GcInfo = nullptr;
+  Context.TM = nullptr;
+  return IsPublished;
+}
+
+void BackgroundCompiler::printStatistics(raw_ostream &OS) {
+  std::lock_guard<std::mutex> Guard(Lock);
+  double AveragePublishTime =
+      (NumPublished == 0) ? 0 : (TotalPublishTime / NumPublished);
+  OS << "INFO:  background compiler: " << NumRegistered << " registered, "
+     << NumDropped << " dropped, " << NumQueued << " hot, " << NumPublished
+     << " published, " << NumFailed << " failed; " << Pending.size()
+     << " waiting to get hot; queue depth " << Queue.size() << " (max "
+     << MaxObservedDepth << "); time to publish "
+     << format("%.3f", AveragePublishTime * 1000) << " ms average, "
+     << format("%.3f", MaxPublishTime * 1000) << " ms max\n";
+}
@@ -194,7 +194,9 @@ void EEMemoryManager::reserveUnwindSpace(const object::ObjectFile &Obj) {
 void EEMemoryManager::reserveAllocationSpace(
     uintptr_t CodeSize, uint32_t CodeAlign, uintptr_t RODataSize,
     uint32_t RODataAlign, uintptr_t RWDataSize, uint32_t RWDataAlign) {
-  // Treat all code for now as "hot section"
+  // Treat all code for now as "hot section". The backend has no way to
+  // split a function into separate sections, so exception paths are instead
+  // placed at the end of the hot section by block placement.
   uintptr_t HotCodeSize = CodeSize;
   uintptr_t ColdCodeSize = 0;
 
@@ -0,0 +1,351 @@
+//===---- lib/Jit/EEObjectCache.cpp -----------------------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implementation of the on-disk compiled object cache.
+///
+//===----------------------------------------------------------------------===//
+
+#include "earlyincludes.h"
+#include "jitpch.h"
+#include "LLILCJit.h"
+#include "EEObjectCache.h"
+#include "GcInfo.h"
+#include "jitoptions.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <string>
+#include <system_error>
+
+using namespace llvm;
+using namespace llvm::object;
+
+// Every entry starts with this magic number and version. Bump the version
+// whenever the layout of an entry, or the way keys are computed, changes.
+static const char EntryMagic[8] = {'L', 'L', 'I', 'L', 'C', 'O', 'B', 'J'};
+static const uint32_t EntryVersion = 2;
+
+EEObjectCache::EEObjectCache(LLILCJitContext *Context, StringRef Directory)
+    : Context(Context), Directory(Directory), Key(), FrameInfo(),
+      CachedObject(), CompiledObject() {}
+
+void EEObjectCache::numberSlots(Module &M) {
+  // Number the slots the reader recorded for each GC function, in a stable
+  // order. GcInfoRecorder fills in their offsets during codegen; these are
+  // what gets saved alongside the object.
+  FrameInfo.clear();
+  for (Function &F : M) {
+    if (F.isDeclaration() || !GcInfo::isGcFunction(&F)) {
+      continue;
+    }
+    GcFuncInfo *GcFuncInfo = Context->GcInfo->getGcInfo(&F);
+    if (GcFuncInfo == nullptr) {
+      continue;
+    }
+
+    FunctionRecord Record;
+    Record.F = &F;
+    Record.HasFunclets = false;
+    Record.PSPSymOffset = 0;
+    Record.NumSafepoints = 0;
+    for (Instruction &I : instructions(F)) {
+      AllocaInst *Alloca = dyn_cast<AllocaInst>(&I);
+      if ((Alloca != nullptr) && GcFuncInfo->hasRecord(Alloca)) {
+        SlotRecord Slot;
+        Slot.Alloca = Alloca;
+        Slot.Offset = GcInfo::InvalidPointerOffset;
+        Slot.IsPresent = true;
+        Record.Slots.push_back(Slot);
+      }
+    }
+    FrameInfo.push_back(std::move(Record));
+  }
+}
+
+bool EEObjectCache::lookup(Module &M, const JitOptions &Options) {
+  numberSlots(M);
+
+  // Compute the key from everything that determines the generated code.
+  MD5 Hash;
+  Hash.update(StringRef(EntryMagic, sizeof(EntryMagic)));
+  Hash.update(StringRef(LLVM_VERSION_STRING));
+  Hash.update(StringRef(LLILC_TARGET_TRIPLE));
+  Hash.update(StringRef(Options.TargetCPU));
+  Hash.update(StringRef(Options.TargetFeatures));
+  Hash.update(LLILCJit::TheJit->getBackendOptions());
+  const uint32_t Config[] = {EntryVersion,
+                             Context->Flags,
+                             static_cast<uint32_t>(Options.OptLevel),
+                             Options.UseConservativeGC,
+                             Options.DoInsertStatepoints,
+                             Options.DoTailCallOpt,
+                             Options.ExecuteHandlers,
+                             Options.DoSIMDIntrinsic,
+                             Options.DoIROptimization,
+                             Options.PreferredIntrinsicSIMDVectorLength};
+  Hash.update(ArrayRef<uint8_t>(reinterpret_cast<const uint8_t *>(Config),
+                                sizeof(Config)));
+  std::string IR;
+  raw_string_ostream IRStream(IR);
+  M.print(IRStream, nullptr);
+  Hash.update(IRStream.str());
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  MD5::stringifyResult(Result, Key);
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> EntryOrError =
+      MemoryBuffer::getFile(getEntryPath());
+  if (!EntryOrError) {
+    return false;
+  }
+
+  if (!parseEntry((*EntryOrError)->getMemBufferRef()) ||
+      !hasValidHandles(CachedObject->getMemBufferRef())) {
+    if (Context->Options->DumpLevel >= ::DumpLevel::SUMMARY) {
+      dbgs() << "INFO:  rejecting stale object cache entry " << Key << " for "
+             << Context->MethodName << "\n";
+    }
+    CachedObject.reset();
+    return false;
+  }
+
+  if (Context->Options->DumpLevel == ::DumpLevel::VERBOSE) {
+    dbgs() << "INFO:  object cache hit " << Key << " for "
+           << Context->MethodName << "\n";
+  }
+  return true;
+}
+
+void EEObjectCache::prepareStore(Module &M, StringRef EntryKey) {
+  numberSlots(M);
+  Key = EntryKey;
+  CachedObject.reset();
+}
+
+std::unique_ptr<MemoryBuffer> EEObjectCache::getObject(const Module *M) {
+  if (!CachedObject) {
+    return nullptr;
+  }
+  return MemoryBuffer::getMemBuffer(CachedObject->getMemBufferRef(), false);
+}
+
+void EEObjectCache::notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) {
+  CompiledObject = MemoryBuffer::getMemBufferCopy(Obj.getBuffer(),
+                                                  Obj.getBufferIdentifier());
+}
+
+void EEObjectCache::restoreGcInfo() {
+  assert(CachedObject && "No cached entry to restore from");
+  for (FunctionRecord &Record : FrameInfo) {
+    GcFuncInfo *GcFuncInfo = Context->GcInfo->getGcInfo(Record.F);
+    GcFuncInfo->HasFunclets = Record.HasFunclets;
+    GcFuncInfo->PSPSymOffset = Record.PSPSymOffset;
+    GcFuncInfo->NumSafepoints = Record.NumSafepoints;
+    for (SlotRecord &Slot : Record.Slots) {
+      const AllocaInst *Alloca =
+          cast<AllocaInst>(static_cast<Value *>(Slot.Alloca));
+      if (Slot.IsPresent) {
+        GcFuncInfo->AllocaMap[Alloca].Offset = Slot.Offset;
+      } else {
+        GcFuncInfo->AllocaMap.erase(Alloca);
+      }
+    }
+  }
+}
+
+bool EEObjectCache::store() {
+  if (!CompiledObject) {
+    return false;
+  }
+
+  std::error_code EC = sys::fs::create_directories(Directory);
+  SmallString<128> TempPath;
+  int FD;
+  if (!EC) {
+    SmallString<128> Model(getEntryPath());
+    Model.append("-%%%%%%.tmp");
+    EC = sys::fs::createUniqueFile(Model, FD, TempPath);
+  }
+  if (EC) {
+    if (Context->Options->DumpLevel >= ::DumpLevel::SUMMARY) {
+      dbgs() << "INFO:  could not write object cache entry for "
+             << Context->MethodName << ": " << EC.message() << "\n";
+    }
+    return false;
+  }
+
+  {
+    raw_fd_ostream Stream(FD, true);
+    auto Write = [&Stream](const void *Data, size_t Size) {
+      Stream.write(static_cast<const char *>(Data), Size);
+    };
+
+    Write(EntryMagic, sizeof(EntryMagic));
+    Write(&EntryVersion, sizeof(EntryVersion));
+    Write(Key.data(), Key.size());
+
+    const uint32_t NumFunctions = FrameInfo.size();
+    Write(&NumFunctions, sizeof(NumFunctions));
+    for (FunctionRecord &Record : FrameInfo) {
+      GcFuncInfo *GcFuncInfo = Context->GcInfo->getGcInfo(Record.F);
+      const uint32_t NumSlots = Record.Slots.size();
+      const uint32_t HasFunclets = GcFuncInfo->HasFunclets;
+      const uint32_t PSPSymOffset = GcFuncInfo->PSPSymOffset;
+      const uint32_t NumSafepoints = GcFuncInfo->NumSafepoints;
+      Write(&NumSlots, sizeof(NumSlots));
+      Write(&HasFunclets, sizeof(HasFunclets));
+      Write(&PSPSymOffset, sizeof(PSPSymOffset));
+      Write(&NumSafepoints, sizeof(NumSafepoints));
+
+      for (SlotRecord &Slot : Record.Slots) {
+        // Slots whose allocas were optimized away, or whose records were
+        // dropped, must be dropped again when the entry is restored.
+        const AllocaInst *Alloca =
+            cast_or_null<AllocaInst>(static_cast<Value *>(Slot.Alloca));
+        const uint32_t IsPresent =
+            (Alloca != nullptr) && GcFuncInfo->hasRecord(Alloca);
+        const int32_t Offset = IsPresent ? GcFuncInfo->AllocaMap[Alloca].Offset
+                                         : GcInfo::InvalidPointerOffset;
+        Write(&Offset, sizeof(Offset));
+        Write(&IsPresent, sizeof(IsPresent));
+      }
+    }
+
+    const uint64_t ObjectSize = CompiledObject->getBufferSize();
+    Write(&ObjectSize, sizeof(ObjectSize));
+    Write(CompiledObject->getBufferStart(), ObjectSize);
+
+    if (Stream.has_error()) {
+      Stream.clear_error();
+      EC = std::make_error_code(std::errc::io_error);
+    }
+  }
+
+  // Publish the entry atomically so that concurrent readers never see a
+  // partially written file.
+  if (!EC) {
+    EC = sys::fs::rename(TempPath, getEntryPath());
+  }
+  if (EC) {
+    sys::fs::remove(TempPath);
+    return false;
+  }
+  return true;
+}
+
+bool EEObjectCache::hasValidHandles(MemoryBufferRef Obj) {
+  ErrorOr<std::unique_ptr<ObjectFile>> ObjOrError =
+      ObjectFile::createObjectFile(Obj);
+  if (!ObjOrError) {
+    return false;
+  }
+
+  for (const SymbolRef &Symbol : (*ObjOrError)->symbols()) {
+    if ((Symbol.getFlags() & SymbolRef::SF_Undefined) == 0) {
+      continue;
+    }
+    ErrorOr<StringRef> NameOrError = Symbol.getName();
+    if (!NameOrError) {
+      return false;
+    }
+    StringRef Name = NameOrError.get();
+    // The personality routine is patched up by the EE, see
+    // ObjectLoadListener::recordRelocations.
+    if (Name.empty() || !Name.compare("ProcessCLRException")) {
+      continue;
+    }
+    if (Context->NameToHandleMap.find(Name) ==
+        Context->NameToHandleMap.end()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool EEObjectCache::parseEntry(MemoryBufferRef Entry) {
+  const char *Current = Entry.getBufferStart();
+  const char *End = Entry.getBufferEnd();
+  auto Read = [&Current, End](void *Data, size_t Size) {
+    if (static_cast<size_t>(End - Current) < Size) {
+      return false;
+    }
+    memcpy(Data, Current, Size);
+    Current += Size;
+    return true;
+  };
+
+  char Magic[sizeof(EntryMagic)];
+  uint32_t Version;
+  if (!Read(Magic, sizeof(Magic)) ||
+      (memcmp(Magic, EntryMagic, sizeof(Magic)) != 0) ||
+      !Read(&Version, sizeof(Version)) || (Version != EntryVersion)) {
+    return false;
+  }
+
+  // Guard against renamed or copied entries.
+  SmallString<32> EntryKey;
+  EntryKey.resize(Key.size());
+  if (!Read(EntryKey.data(), EntryKey.size()) ||
+      (EntryKey.str() != Key.str())) {
+    return false;
+  }
+
+  uint32_t NumFunctions;
+  if (!Read(&NumFunctions, sizeof(NumFunctions)) ||
+      (NumFunctions != FrameInfo.size())) {
+    return false;
+  }
+  for (FunctionRecord &Record : FrameInfo) {
+    uint32_t NumSlots;
+    uint32_t HasFunclets;
+    if (!Read(&NumSlots, sizeof(NumSlots)) ||
+        (NumSlots != Record.Slots.size()) ||
+        !Read(&HasFunclets, sizeof(HasFunclets)) ||
+        !Read(&Record.PSPSymOffset, sizeof(Record.PSPSymOffset)) ||
+        !Read(&Record.NumSafepoints, sizeof(Record.NumSafepoints))) {
+      return false;
+    }
+    Record.HasFunclets = (HasFunclets != 0);
+
+    for (SlotRecord &Slot : Record.Slots) {
+      uint32_t IsPresent;
+      if (!Read(&Slot.Offset, sizeof(Slot.Offset)) ||
+          !Read(&IsPresent, sizeof(IsPresent))) {
+        return false;
+      }
+      Slot.IsPresent = (IsPresent != 0);
+    }
+  }
+
+  uint64_t ObjectSize;
+  if (!Read(&ObjectSize, sizeof(ObjectSize)) ||
+      (static_cast<uint64_t>(End - Current) != ObjectSize)) {
+    return false;
+  }
+  CachedObject = MemoryBuffer::getMemBufferCopy(StringRef(Current, ObjectSize),
+                                                Context->MethodName);
+  return true;
+}
+
+SmallString<128> EEObjectCache::getEntryPath() {
+  SmallString<128> Path(Directory);
+  sys::path::append(Path, Twine(Key) + ".llilc");
+  return Path;
+}
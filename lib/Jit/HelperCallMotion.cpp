@@ -0,0 +1,179 @@
+//===---- lib/Jit/HelperCallMotion.cpp --------------------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Hoisting and commoning of moveable helper calls.
+///
+//===----------------------------------------------------------------------===//
+
+#include "HelperCallMotion.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+
+namespace {
+
+class HelperCallMotion : public FunctionPass {
+public:
+  static char ID;
+
+  HelperCallMotion(HelperCallStatistics *Statistics)
+      : FunctionPass(ID), Statistics(Statistics), DT(nullptr), LI(nullptr) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  /// \brief Move \p Call to the preheader of each enclosing loop in turn, as
+  /// long as its operands are invariant in the loop.
+  /// \returns true if the call was moved.
+  bool hoist(CallInst *Call);
+
+  /// Check whether \p Call makes the same call as \p Dominator.
+  bool isSameCall(CallInst *Dominator, CallInst *Call);
+
+  HelperCallStatistics *Statistics;
+  DominatorTree *DT;
+  LoopInfo *LI;
+};
+
+} // anonymous namespace
+
+char HelperCallMotion::ID = 0;
+
+/// \brief Get the address of the helper that \p Call calls.
+///
+/// The reader casts the address to a pointer to a function type built from
+/// the arguments and the result, so calls to the same helper may use
+/// different function types.
+static Value *getHelperAddress(CallInst *Call) {
+  Value *Target = Call->getCalledValue();
+  Operator *Cast = dyn_cast<Operator>(Target);
+  if ((Cast != nullptr) && (Cast->getOpcode() == Instruction::IntToPtr)) {
+    return Cast->getOperand(0);
+  }
+  return Target;
+}
+
+bool HelperCallMotion::hoist(CallInst *Call) {
+  bool IsHoisted = false;
+  for (Loop *L = LI->getLoopFor(Call->getParent()); L != nullptr;
+       L = L->getParentLoop()) {
+    BasicBlock *Preheader = L->getLoopPreheader();
+    if (Preheader == nullptr) {
+      break;
+    }
+
+    // Simple computations of the operands, such as casts, move along with
+    // the call.
+    Instruction *InsertPoint = Preheader->getTerminator();
+    bool IsInvariant = true;
+    for (Value *Operand : Call->operands()) {
+      bool Changed = false;
+      if (!L->makeLoopInvariant(Operand, Changed, InsertPoint)) {
+        IsInvariant = false;
+        break;
+      }
+    }
+    if (!IsInvariant) {
+      break;
+    }
+
+    Call->moveBefore(InsertPoint);
+    IsHoisted = true;
+  }
+  return IsHoisted;
+}
+
+bool HelperCallMotion::isSameCall(CallInst *Dominator, CallInst *Call) {
+  if ((getHelperAddress(Dominator) != getHelperAddress(Call)) ||
+      (Dominator->getNumArgOperands() != Call->getNumArgOperands())) {
+    return false;
+  }
+  for (unsigned I = 0, E = Call->getNumArgOperands(); I < E; ++I) {
+    if (Dominator->getArgOperand(I) != Call->getArgOperand(I)) {
+      return false;
+    }
+  }
+
+  // A call whose result is used can only be replaced by one that produces
+  // the same type of result.
+  return Call->use_empty() || (Dominator->getType() == Call->getType());
+}
+
+bool HelperCallMotion::runOnFunction(Function &F) {
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  unsigned MoveableKind =
+      F.getContext().getMDKindID(MOVEABLE_HELPER_METADATA_NAME);
+
+  // Calls that may unwind to a handler end their block, and calls within a
+  // funclet have to stay in it, so both are left where they are.
+  SmallVector<CallInst *, 8> Calls;
+  for (BasicBlock &Block : F) {
+    for (Instruction &Instr : Block) {
+      CallInst *Call = dyn_cast<CallInst>(&Instr);
+      if ((Call == nullptr) || (Call->getMetadata(MoveableKind) == nullptr)) {
+        continue;
+      }
+      ++Statistics->NumCalls;
+      if (Call->getNumOperandBundles() == 0) {
+        Calls.push_back(Call);
+      }
+    }
+  }
+
+  bool Changed = false;
+  for (CallInst *Call : Calls) {
+    if (hoist(Call)) {
+      ++Statistics->NumHoisted;
+      Changed = true;
+    }
+  }
+
+  // Now that the calls have been moved up, replace each call that repeats
+  // one that dominates it.
+  for (unsigned I = 0; I < Calls.size(); ++I) {
+    CallInst *Call = Calls[I];
+    for (unsigned J = 0; J < Calls.size(); ++J) {
+      CallInst *Dominator = Calls[J];
+      if ((J == I) || !DT->dominates(Dominator, Call) ||
+          !isSameCall(Dominator, Call)) {
+        continue;
+      }
+      if (!Call->use_empty()) {
+        Call->replaceAllUsesWith(Dominator);
+      }
+      Call->eraseFromParent();
+      Calls.erase(Calls.begin() + I);
+      --I;
+      ++Statistics->NumRemoved;
+      Changed = true;
+      break;
+    }
+  }
+
+  return Changed;
+}
+
+FunctionPass *createHelperCallMotionPass(HelperCallStatistics *Statistics) {
+  return new HelperCallMotion(Statistics);
+}
@@ -0,0 +1,133 @@
+//===---- lib/Jit/JitTimeLog.cpp --------------------------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implementation of the per-method compile time log.
+///
+//===----------------------------------------------------------------------===//
+
+#include "JitTimeLog.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+
+#ifdef LLVM_ON_WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace llvm;
+
+/// Names of the phases in the log, indexed by \p JitPhase.
+static const char *const PhaseNames[] = {"read",    "optimize",  "safepoints",
+                                         "codegen", "debuginfo", "gcinfo"};
+
+static_assert(sizeof(PhaseNames) / sizeof(PhaseNames[0]) ==
+                  (unsigned)JitPhase::NumPhases,
+              "Missing phase name");
+
+/// \brief Get the CPU time used by the calling thread, in seconds.
+///
+/// Other threads, such as background compiler workers, may be jitting at the
+/// same time, so the process CPU time would not be the method's.
+static double getThreadCpuTime() {
+#ifdef LLVM_ON_WIN32
+  FILETIME CreationTime, ExitTime, KernelTime, UserTime;
+  if (!GetThreadTimes(GetCurrentThread(), &CreationTime, &ExitTime,
+                      &KernelTime, &UserTime)) {
+    return 0;
+  }
+  auto ToTicks = [](const FILETIME &Time) {
+    return ((uint64_t)Time.dwHighDateTime << 32) | Time.dwLowDateTime;
+  };
+  // FILETIME counts 100 nanosecond ticks.
+  return (ToTicks(KernelTime) + ToTicks(UserTime)) * 1e-7;
+#else
+  struct timespec Time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &Time) != 0) {
+    return 0;
+  }
+  return Time.tv_sec + Time.tv_nsec * 1e-9;
+#endif
+}
+
+MethodTimeRecord::Scope::Scope(MethodTimeRecord *Record, JitPhase Phase)
+    : Record(Record), Phase(Phase) {
+  if (Record != nullptr) {
+    StartWallTime = TimeRecord::getCurrentTime(true).getWallTime();
+    StartCpuTime = getThreadCpuTime();
+  }
+}
+
+void MethodTimeRecord::Scope::stop() {
+  if (Record != nullptr) {
+    double CpuTime = getThreadCpuTime();
+    double WallTime = TimeRecord::getCurrentTime(false).getWallTime();
+    Record->WallTime[(unsigned)Phase] += WallTime - StartWallTime;
+    Record->CpuTime[(unsigned)Phase] += CpuTime - StartCpuTime;
+    Record = nullptr;
+  }
+}
+
+JitTimeLog::JitTimeLog(StringRef Path) {
+  std::error_code EC;
+  Stream.reset(new raw_fd_ostream(Path, EC, sys::fs::F_Append));
+  if (EC) {
+    errs() << "Could not open " << Path << ": " << EC.message() << "\n";
+    Stream.reset();
+  }
+}
+
+/// Write \p Name as a JSON string.
+static void writeString(raw_ostream &OS, StringRef Name) {
+  OS << '"';
+  for (unsigned char C : Name) {
+    if ((C == '"') || (C == '\\')) {
+      OS << '\\' << C;
+    } else if (C < 0x20) {
+      OS << format("\\u%04x", C);
+    } else {
+      OS << C;
+    }
+  }
+  OS << '"';
+}
+
+void JitTimeLog::write(StringRef MethodName, const MethodTimeRecord &Record) {
+  if (!Stream) {
+    return;
+  }
+
+  // Format the line first, so the lock is only held to write it out.
+  std::string Line;
+  raw_string_ostream OS(Line);
+  OS << "{\"method\":";
+  writeString(OS, MethodName);
+  OS << ",\"il_bytes\":" << Record.ILSize
+     << ",\"cache_hit\":" << (Record.IsCacheHit ? "true" : "false")
+     << ",\"ir_read\":" << Record.ReadInstructions
+     << ",\"ir_final\":" << Record.FinalInstructions
+     << ",\"code_bytes\":" << Record.CodeSize
+     << ",\"stackmap_bytes\":" << Record.StackMapSize
+     << ",\"reader_temp_bytes\":" << Record.TempBytes
+     << ",\"reader_proc_bytes\":" << Record.ProcBytes << ",\"phases\":{";
+  for (unsigned I = 0; I < (unsigned)JitPhase::NumPhases; ++I) {
+    OS << (I == 0 ? "" : ",") << '"' << PhaseNames[I] << "\":{\"wall_ms\":"
+       << format("%.3f", Record.WallTime[I] * 1000)
+       << ",\"cpu_ms\":" << format("%.3f", Record.CpuTime[I] * 1000) << "}";
+  }
+  OS << "}}\n";
+  OS.flush();
+
+  std::lock_guard<std::mutex> Guard(Lock);
+  *Stream << Line;
+  Stream->flush();
+}
@@ -21,8 +21,14 @@
 #include "compiler.h"
 #include "readerir.h"
 #include "abi.h"
+#include "BackgroundCompiler.h"
 #include "EEMemoryManager.h"
+#include "EEObjectCache.h"
 #include "EEObjectLinkingLayer.h"
+#include "HelperCallMotion.h"
+#include "JitTimeLog.h"
+#include "RangeCheckElimination.h"
+#include "WriteBarrierElimination.h"
 #include "llvm/CodeGen/GCs.h"
 #include "llvm/Config/llvm-config.h"
 #include "llvm/DebugInfo/DIContext.h"
@@ -44,20 +50,24 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/InitializePasses.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Object/SymbolSize.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Errno.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include <mutex>
 #include <string>
 #if defined(WIN32) && defined(_MSC_VER)
 #include <crtdbg.h>
@@ -80,7 +90,11 @@ public:
       const object::ObjectFile &Obj = *PObj->getBinary();
       const RuntimeDyld::LoadedObjectInfo &L = *LoadedObjInfos[I];
 
-      getDebugInfoForObject(Obj, L);
+      {
+        MethodTimeRecord::Scope Timer(Context->TimeRecord,
+                                      JitPhase::DebugInfo);
+        getDebugInfoForObject(Obj, L);
+      }
 
       recordRelocations(Obj, L);
 
@@ -203,22 +217,110 @@ ICorJitCompiler *__stdcall getJit() {
       Opts["disable-cgp-gc-opts"]->addOccurrence(0, "disable-cgp-gc-opts",
                                                  "true");
     }
+
+    // Let statepoint lowering keep live GC values in callee-saved registers
+    // across safepoints, rather than spilling them all to the stack, when
+    // the backend supports it. GcInfoEmitter reports such register slots.
+    // Values beyond the number of free callee-saved registers are spilled.
+    auto GcRegs = Opts.find("max-registers-for-gc-values");
+    if ((GcRegs != Opts.end()) && (GcRegs->second->getNumOccurrences() == 0)) {
+      const char *MaxGcRegisters = "5";
+      GcRegs->second->addOccurrence(0, "max-registers-for-gc-values",
+                                    MaxGcRegisters);
+    }
+
+    // Let codegen fold the null checks the reader marks as implicit onto the
+    // load or store they guard. Only branches carrying make.implicit metadata
+    // are considered, and the reader adds it only when
+    // COMPlus_JitImplicitNullChecks is set.
+    auto NullChecks = Opts.find("enable-implicit-null-checks");
+    if ((NullChecks != Opts.end()) &&
+        (NullChecks->second->getNumOccurrences() == 0)) {
+      NullChecks->second->addOccurrence(0, "enable-implicit-null-checks",
+                                        "true");
+    }
   }
 
   return LLILCJit::TheJit;
 }
 
 // Construct the JIT instance
-LLILCJit::LLILCJit() {
+LLILCJit::LLILCJit() : Background(nullptr), TimeLog(nullptr) {
   PassRegistry &Registry = *PassRegistry::getPassRegistry();
   initializeCore(Registry);
   initializeScalarOpts(Registry);
+  initializeInstCombine(Registry);
+  initializeAnalysis(Registry);
+  initializeTransformUtils(Registry);
 
   InitializeNativeTarget();
   InitializeNativeTargetAsmPrinter();
   InitializeNativeTargetAsmParser();
+  InitializeNativeTargetDisassembler();
 
   llvm::linkCoreCLRGC();
+
+  // Detect the host CPU once. Each jit request picks the features it may use
+  // from these, see getHostFeatures.
+  HostCPU = sys::getHostCPUName();
+  if (!sys::getHostCPUFeatures(HostFeatures)) {
+    HostFeatures.clear();
+  }
+
+  // getJit parses these into LLVM's command line options. They can change
+  // the generated code, so the object cache needs to know them.
+  const char *Options = getenv("COMPlus_AltJitOptions");
+  if (Options != nullptr) {
+    BackendOptions = Options;
+  }
+}
+
+// The EE reports the instruction set extensions jitted code may use with
+// these jit flags. corjit.h only declares them when the EE is built for
+// AMD64, so their values are repeated here.
+enum CpuCompileFlag : unsigned {
+  CpuCompileUseSSE3_4 = 0x00000200,
+  CpuCompileUseAVX = 0x00000400,
+  CpuCompileUseAVX2 = 0x00000800,
+  CpuCompileUseAVX512 = 0x00001000
+};
+
+void LLILCJit::getHostFeatures(unsigned CpuCompileFlags,
+                               StringMap<bool> &Features) const {
+  Features = HostFeatures;
+  if (Features.empty()) {
+    return;
+  }
+
+  // The EE may have disabled extensions the host has, for instance via
+  // COMPlus_EnableAVX. Each extension is only enabled along with the ones
+  // before it.
+  if ((CpuCompileFlags & CpuCompileUseSSE3_4) == 0) {
+    CpuCompileFlags = 0;
+    Features["sse3"] = false;
+    Features["ssse3"] = false;
+    Features["sse4.1"] = false;
+    Features["sse4.2"] = false;
+  }
+  if ((CpuCompileFlags & CpuCompileUseAVX) == 0) {
+    CpuCompileFlags = 0;
+    Features["avx"] = false;
+    Features["fma"] = false;
+    Features["f16c"] = false;
+  }
+  if ((CpuCompileFlags & CpuCompileUseAVX2) == 0) {
+    CpuCompileFlags = 0;
+    Features["avx2"] = false;
+  }
+  if ((CpuCompileFlags & CpuCompileUseAVX512) == 0) {
+    Features["avx512f"] = false;
+  }
+}
+
+unsigned LLILCJit::getSIMDVectorLength(const StringMap<bool> &Features) {
+  // AVX2 adds the integer operations on ymm registers. Without it, integer
+  // vectors wider than an xmm register would be split.
+  return Features.lookup("avx2") ? 32 : 16;
 }
 
 #ifdef LLVM_ON_WIN32
@@ -253,6 +355,39 @@ LLILCJitContext::~LLILCJitContext() {
   State->JitContext = TopContext->Next;
 }
 
+TargetMachine *
+LLILCJitPerThreadState::getTargetMachine(CodeGenOpt::Level OptLevel,
+                                         CodeModel::Model CodeModel,
+                                         bool IsPrejit, StringRef CPU,
+                                         StringRef Features,
+                                         std::string &ErrStr) {
+  std::unique_ptr<TargetMachine> &TM = TargetMachineMap[std::make_tuple(
+      OptLevel, CodeModel, IsPrejit, CPU.str(), Features.str())];
+  if (!TM) {
+    const llvm::Target *TheTarget =
+        TargetRegistry::lookupTarget(LLILC_TARGET_TRIPLE, ErrStr);
+    if (!TheTarget) {
+      return nullptr;
+    }
+    TargetOptions Options;
+    TM.reset(TheTarget->createTargetMachine(LLILC_TARGET_TRIPLE, CPU, Features,
+                                            Options, Reloc::Default, CodeModel,
+                                            OptLevel));
+  }
+  return TM.get();
+}
+
+/// Count the instructions in \p M, for the compile time log.
+static uint64_t countInstructions(const Module &M) {
+  uint64_t Count = 0;
+  for (const Function &F : M) {
+    for (const BasicBlock &Block : F) {
+      Count += Block.size();
+    }
+  }
+  return Count;
+}
+
 // This is the method invoked by the EE to Jit code.
 CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
                                      CORINFO_METHOD_INFO *MethodInfo,
@@ -270,11 +405,7 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
   *NativeSizeOfCode = 0;
 
   // Set up state for this thread (if necessary)
-  LLILCJitPerThreadState *PerThreadState = State.get();
-  if (PerThreadState == nullptr) {
-    PerThreadState = new LLILCJitPerThreadState();
-    State.set(PerThreadState);
-  }
+  LLILCJitPerThreadState *PerThreadState = getPerThreadState();
 
   // Set up context for this Jit request
   LLILCJitContext Context(PerThreadState);
@@ -312,19 +443,21 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
   if (JitOptions.IsAltJit && !JitOptions.IsExcludeMethod) {
     Context.Options = &JitOptions;
 
-    // Construct the TargetMachine that we will emit code for
-    std::string ErrStr;
-    const llvm::Target *TheTarget =
-        TargetRegistry::lookupTarget(LLILC_TARGET_TRIPLE, ErrStr);
-    if (!TheTarget) {
-      errs() << "Could not create Target: " << ErrStr << "\n";
-      return CORJIT_INTERNALERROR;
-    }
-    TargetOptions Options;
+    // Get the TargetMachine that we will emit code for
     CodeGenOpt::Level OptLevel;
     bool IsNgen = Context.Flags & CORJIT_FLG_PREJIT;
     bool IsReadyToRun = Context.Flags & CORJIT_FLG_READYTORUN;
 
+    // With background compilation, methods that miss in the object cache
+    // get cheap code now and are recompiled at full optimization into the
+    // cache by BackgroundCompiler. Code found in the cache was generated by
+    // the background compiler, so codegen only ever runs the cheap way.
+    bool IsBackgroundEnabled =
+        (JitOptions.BackgroundThreads > 0) &&
+        !JitOptions.ObjectCachePath.empty() && !Context.HasLoadedBitCode &&
+        Context.Options->EnableOptimization && !IsNgen && !IsReadyToRun &&
+        llvm_is_multithreaded();
+
     // Optimal code for ReadyToRun should have all calls in call [rel32] form to
     // enable crossgen to use shared delay-load thunks. We can't guarantee that
     // LLVM will always generate this form so we currently don't take advantage
@@ -332,7 +465,8 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
     // calls as possible in that form and use shared delay-load thunks when
     // possible. Setting OptLevel to Default increases the chances of calls via
     // memory and setting CodeModel to Default enables rel32 relocations.
-    if ((Context.Options->EnableOptimization) || IsNgen || IsReadyToRun) {
+    if (((Context.Options->EnableOptimization) || IsNgen || IsReadyToRun) &&
+        !IsBackgroundEnabled) {
       OptLevel = CodeGenOpt::Level::Default;
     } else {
       OptLevel = CodeGenOpt::Level::None;
@@ -340,9 +474,14 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
     }
     llvm::CodeModel::Model CodeModel =
         (IsNgen || IsReadyToRun) ? CodeModel::Default : CodeModel::JITDefault;
-    TargetMachine *TM =
-        TheTarget->createTargetMachine(LLILC_TARGET_TRIPLE, "", "", Options,
-                                       Reloc::Default, CodeModel, OptLevel);
+    std::string ErrStr;
+    TargetMachine *TM = PerThreadState->getTargetMachine(
+        OptLevel, CodeModel, IsNgen || IsReadyToRun, JitOptions.TargetCPU,
+        JitOptions.TargetFeatures, ErrStr);
+    if (!TM) {
+      errs() << "Could not create Target: " << ErrStr << "\n";
+      return CORJIT_INTERNALERROR;
+    }
     Context.TM = TM;
 
     // Set target machine datalayout on the method module.
@@ -362,13 +501,31 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
     orc::IRCompileLayer<decltype(UnwindReserver)> Compiler(
         UnwindReserver, orc::LLILCCompiler(*TM));
 
+    // Reuse previously generated code, if an object cache is configured.
+    std::unique_ptr<EEObjectCache> Cache;
+    if (!JitOptions.ObjectCachePath.empty() && !Context.HasLoadedBitCode) {
+      Cache.reset(new EEObjectCache(&Context, JitOptions.ObjectCachePath));
+      Compiler.setObjectCache(Cache.get());
+    }
+
+    // Record compile times, if they are being logged.
+    std::unique_ptr<MethodTimeRecord> TimeRecord;
+    if (!JitOptions.TimeLogPath.empty()) {
+      TimeRecord.reset(new MethodTimeRecord());
+      Context.TimeRecord = TimeRecord.get();
+    }
+
     // Now jit the method.
     if (Context.Options->DumpLevel == DumpLevel::VERBOSE) {
       dbgs() << "INFO:  jitting method " << Context.MethodName
              << " using LLILCJit\n";
     }
     bool ContainsUnmanagedCall;
-    bool HasMethod = this->readMethod(&Context, ContainsUnmanagedCall);
+    bool HasMethod;
+    {
+      MethodTimeRecord::Scope Timer(Context.TimeRecord, JitPhase::Read);
+      HasMethod = this->readMethod(&Context, ContainsUnmanagedCall);
+    }
 
 #ifndef FEATURE_VERIFICATION
     bool IsImportOnly = (Context.Flags & CORJIT_FLG_IMPORT_ONLY) != 0;
@@ -391,18 +548,46 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
                << "\n";
         Context.CurrentModule->dump();
       }
-      // If using Precise GC, run the GC-Safepoint insertion
-      // and lowering passes before generating code.  If
-      // using conservative GC but the function has an unmanaged
-      // call, skip safepoint insertion but run the lowering
-      // pass to lower the gc-transition arguments.
-      if (ContainsUnmanagedCall || Context.Options->DoInsertStatepoints) {
-        legacy::PassManager Passes;
-        if (Context.Options->DoInsertStatepoints) {
-          Passes.add(createPlaceSafepointsPass());
+
+      // Look for code generated by an earlier run. The cache key is computed
+      // from the reader's output, so this must precede any other pass. On a
+      // hit the cached object stands in for the output of all of them.
+      bool IsCacheHit = Cache && Cache->lookup(*M, JitOptions);
+      if (TimeRecord) {
+        TimeRecord->IsCacheHit = IsCacheHit;
+        TimeRecord->ReadInstructions = countInstructions(*M);
+      }
+
+      // On a miss, register the method for recompilation and skip the IR
+      // optimizer for now. The cheap code counts its calls so that only
+      // methods that get hot are recompiled. It must not be stored in the
+      // cache, since the key describes optimized code.
+      bool IsCheapCompile = !IsCacheHit && IsBackgroundEnabled;
+      if (IsCheapCompile) {
+        BackgroundCompiler *Background =
+            getBackgroundCompiler(JitOptions.BackgroundThreads);
+        uint32_t *CallCounter =
+            Background->enqueue(Context, JitOptions.ObjectCachePath,
+                                Cache->getKey(), ContainsUnmanagedCall);
+        if (CallCounter != nullptr) {
+          BackgroundCompiler::insertCallCounter(*M, CallCounter);
         }
-        Passes.add(createRewriteStatepointsForGCPass());
-        Passes.run(*M);
+      }
+
+      // Clean up the reader's output before any GC lowering takes place.
+      if (!IsCacheHit && !IsCheapCompile &&
+          Context.Options->DoIROptimization) {
+        MethodTimeRecord::Scope Timer(Context.TimeRecord, JitPhase::Optimize);
+        optimizeMethod(&Context);
+      }
+
+      if (!IsCacheHit) {
+        MethodTimeRecord::Scope Timer(Context.TimeRecord,
+                                      JitPhase::Safepoints);
+        placeSafepoints(&Context, ContainsUnmanagedCall);
+      }
+      if (TimeRecord) {
+        TimeRecord->FinalInstructions = countInstructions(*M);
       }
 
       // Use a custom resolver that will tell the dynamic linker to skip
@@ -410,11 +595,14 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
       // report relocations for those symbols via Jit interface's
       // recordRelocation method.
       EESymbolResolver Resolver(&Context.NameToHandleMap);
+      MethodTimeRecord::Scope CodegenTimer(Context.TimeRecord,
+                                           JitPhase::Codegen);
       auto HandleSet =
           Compiler.addModuleSet<ArrayRef<Module *>>(M.get(), &MM, &Resolver);
 
       *NativeEntry =
           (BYTE *)Compiler.findSymbol(Context.MethodName, false).getAddress();
+      CodegenTimer.stop();
 
       // TODO: ColdCodeSize, or separated code, is not enabled or included.
       *NativeSizeOfCode = Context.HotCodeSize + Context.ReadOnlyDataSize;
@@ -433,10 +621,21 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
       // at a fixed offset from *NativeEntry.
       assert(*NativeEntry == MM.getHotCodeBlock() &&
              "Expect the JITted method at the beginning of the code block");
-      GcInfoAllocator GcInfoAllocator;
-      GcInfoEmitter GcInfoEmitter(&Context, MM.getStackMapSection(),
-                                  &GcInfoAllocator);
-      GcInfoEmitter.emitGCInfo();
+      // GcInfoRecorder did not run for a cached object; use the frame
+      // information saved along with it instead.
+      if (IsCacheHit) {
+        Cache->restoreGcInfo();
+      }
+      {
+        MethodTimeRecord::Scope Timer(Context.TimeRecord, JitPhase::GcInfo);
+        GcInfoAllocator GcInfoAllocator;
+        GcInfoEmitter GcInfoEmitter(&Context, MM.getStackMapSection(),
+                                    MM.getHotCodeBlock(), &GcInfoAllocator);
+        GcInfoEmitter.emitGCInfo();
+      }
+      if (Cache && !IsCacheHit && !IsCheapCompile) {
+        Cache->store();
+      }
 
       // Dump out any enabled timing info.
       TimerGroup::printAll(errs());
@@ -446,10 +645,25 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
 
       // Tell the CLR that we've successfully generated code for this method.
       Result = CORJIT_OK;
+
+      if (TimeRecord) {
+        TimeRecord->ILSize = MethodInfo->ILCodeSize;
+        TimeRecord->CodeSize = *NativeSizeOfCode;
+        TimeRecord->StackMapSize = Context.StackMapSize;
+        TimeRecord->TempBytes = Context.TempArena.getTotalBytesAllocated();
+        TimeRecord->ProcBytes = Context.ProcArena.getTotalBytesAllocated();
+        getTimeLog(JitOptions.TimeLogPath)
+            ->write(Context.MethodName, *TimeRecord);
+      }
     }
 
-    // Clean up a bit
-    delete Context.TM;
+    if (JitOptions.DumpLevel >= DumpLevel::SUMMARY) {
+      dbgs() << "INFO:  reader memory for " << Context.MethodName << ": temp "
+             << Context.TempArena.getTotalBytesAllocated() << " bytes, proc "
+             << Context.ProcArena.getTotalBytesAllocated() << " bytes\n";
+    }
+
+    // Clean up a bit. The TargetMachine is owned by the per-thread state.
     Context.TM = nullptr;
   } else {
     // This method was not selected for jitting by LLILC.
@@ -464,6 +678,7 @@ CorJitResult LLILCJit::compileMethod(ICorJitInfo *JitInfo,
   delete Context.GcInfo;
   Context.TheABIInfo = nullptr;
   Context.GcInfo = nullptr;
+  Context.ProcArena.reset();
 
   return Result;
 }
@@ -532,9 +747,13 @@ bool LLILCJit::readMethod(LLILCJitContext *JitContext,
     if (DumpLevel >= ::DumpLevel::SUMMARY) {
       errs() << "Failed to read " << FuncName << '[' << Nyi.reason() << "]\n";
     }
+    JitContext->TempArena.reset();
     return false;
   }
 
+  // Reader-lifetime memory is no longer needed.
+  JitContext->TempArena.reset();
+
   bool IsOk = !verifyModule(*JitContext->CurrentModule, &dbgs());
   assert(IsOk && "verification failed");
 
@@ -556,6 +775,172 @@ bool LLILCJit::readMethod(LLILCJitContext *JitContext,
   return IsOk;
 }
 
+// Run the mid-level optimizer over the IR produced by the reader.
+void LLILCJit::optimizeMethod(LLILCJitContext *JitContext) {
+  Module *M = JitContext->CurrentModule;
+  ::OptLevel OptLevel = JitContext->Options->OptLevel;
+  assert(OptLevel != ::OptLevel::DEBUG_CODE && "Should not optimize");
+
+  legacy::FunctionPassManager FPM(M);
+
+  // Promote locals to SSA and remove the obvious redundancy in the
+  // reader's output. Locals that hold GC references or GC aggregates
+  // are frame-escaped by the reader so these passes leave them alone.
+  FPM.add(createSROAPass());
+  FPM.add(createEarlyCSEPass());
+  FPM.add(createCFGSimplificationPass());
+  FPM.add(createInstructionCombiningPass());
+
+  if (OptLevel != ::OptLevel::SMALL_CODE) {
+    // Fold redundant null/bounds checks and loads, and hoist loop
+    // invariant code. Helper calls are left to the helper call motion
+    // pass below, since the reader doesn't mark them readnone. MemCpyOpt
+    // is left out: it merges the stores of inline block copies and fills
+    // into llvm.memcpy and llvm.memset, which codegen may turn into calls
+    // to the C runtime that the jit can't resolve.
+    FPM.add(createReassociatePass());
+    FPM.add(createLoopRotatePass());
+    FPM.add(createLICMPass());
+    FPM.add(createGVNPass());
+    FPM.add(createSCCPPass());
+    FPM.add(createInstructionCombiningPass());
+    FPM.add(createDeadStoreEliminationPass());
+  }
+
+  // Hoist the static base helper calls out of loops and common them, now
+  // that the handles they are passed have been hoisted and commoned.
+  HelperCallStatistics HelperCalls = {0, 0, 0};
+  FPM.add(createHelperCallMotionPass(&HelperCalls));
+
+  // Remove the array range checks implied by loop bounds and by other
+  // checks, now that loads of array lengths have been commoned.
+  RangeCheckStatistics RangeChecks = {0, 0};
+  FPM.add(createRangeCheckEliminationPass(&RangeChecks));
+
+  // Replace the write barriers that stores of null, stores to the stack and
+  // stores into new objects don't need.
+  WriteBarrierStatistics WriteBarriers = {0, 0, 0};
+  FPM.add(createWriteBarrierEliminationPass(&WriteBarriers));
+
+  if (OptLevel == ::OptLevel::FAST_CODE) {
+    FPM.add(createIndVarSimplifyPass());
+    FPM.add(createLoopDeletionPass());
+    FPM.add(createAggressiveDCEPass());
+  }
+
+  // Clean up the control flow left behind by the passes above.
+  FPM.add(createCFGSimplificationPass());
+
+#if !defined(NDEBUG)
+  FPM.add(createVerifierPass());
+#endif
+
+  FPM.doInitialization();
+  for (Function &F : *M) {
+    // Only optimize methods we generated; the safepoint poll helper is
+    // handled by the safepoint placement pass itself.
+    if (F.isDeclaration() || !GcInfo::isGcFunction(&F)) {
+      continue;
+    }
+    FPM.run(F);
+  }
+  FPM.doFinalization();
+
+  if ((JitContext->Options->DumpLevel >= ::DumpLevel::SUMMARY) &&
+      (HelperCalls.NumCalls > 0)) {
+    dbgs() << "INFO:  hoisted " << HelperCalls.NumHoisted << " and removed "
+           << HelperCalls.NumRemoved << " of " << HelperCalls.NumCalls
+           << " moveable helper calls in " << JitContext->MethodName << "\n";
+  }
+
+  if ((JitContext->Options->DumpLevel >= ::DumpLevel::SUMMARY) &&
+      (RangeChecks.NumChecks > 0)) {
+    dbgs() << "INFO:  removed " << RangeChecks.NumRemoved << " of "
+           << RangeChecks.NumChecks << " range checks in "
+           << JitContext->MethodName << "\n";
+  }
+
+  if ((JitContext->Options->DumpLevel >= ::DumpLevel::SUMMARY) &&
+      (WriteBarriers.NumBarriers > 0)) {
+    dbgs() << "INFO:  removed " << WriteBarriers.NumRemoved << " of "
+           << WriteBarriers.NumBarriers << " write barriers ("
+           << WriteBarriers.NumChecked << " checked) in "
+           << JitContext->MethodName << "\n";
+  }
+
+  if (JitContext->Options->DumpLevel == ::DumpLevel::VERBOSE) {
+    dbgs() << "INFO:  optimized IR for " << JitContext->MethodName << "\n";
+    M->dump();
+  }
+}
+
+void LLILCJit::placeSafepoints(LLILCJitContext *JitContext,
+                               bool ContainsUnmanagedCall) {
+  // If using Precise GC, run the GC-Safepoint insertion
+  // and lowering passes before generating code.  If
+  // using conservative GC but the function has an unmanaged
+  // call, skip safepoint insertion but run the lowering
+  // pass to lower the gc-transition arguments.
+  if (!ContainsUnmanagedCall && !JitContext->Options->DoInsertStatepoints) {
+    return;
+  }
+
+  legacy::PassManager Passes;
+  if (JitContext->Options->DoInsertStatepoints) {
+    Passes.add(createPlaceSafepointsPass());
+  }
+  Passes.add(createRewriteStatepointsForGCPass());
+  Passes.run(*JitContext->CurrentModule);
+}
+
+LLILCJitPerThreadState *LLILCJit::getPerThreadState() {
+  LLILCJitPerThreadState *PerThreadState = State.get();
+  if (PerThreadState == nullptr) {
+    PerThreadState = new LLILCJitPerThreadState();
+    State.set(PerThreadState);
+  }
+  return PerThreadState;
+}
+
+BackgroundCompiler *LLILCJit::getBackgroundCompiler(unsigned NumThreads) {
+  BackgroundCompiler *Compiler = Background.load();
+  if (Compiler == nullptr) {
+    static std::mutex StartLock;
+    std::lock_guard<std::mutex> Guard(StartLock);
+    Compiler = Background.load();
+    if (Compiler == nullptr) {
+      Compiler = new BackgroundCompiler(NumThreads);
+      Background.store(Compiler);
+    }
+  }
+  return Compiler;
+}
+
+JitTimeLog *LLILCJit::getTimeLog(StringRef Path) {
+  JitTimeLog *Log = TimeLog.load();
+  if (Log == nullptr) {
+    static std::mutex OpenLock;
+    std::lock_guard<std::mutex> Guard(OpenLock);
+    Log = TimeLog.load();
+    if (Log == nullptr) {
+      Log = new JitTimeLog(Path);
+      TimeLog.store(Log);
+    }
+  }
+  return Log;
+}
+
+// Notification from the runtime that the process is shutting down.
+void LLILCJit::ProcessShutdownWork(ICorStaticInfo *StaticInfo) {
+  // Methods still waiting are dropped; they are registered again the next
+  // time the process runs them. Other threads may still be jitting with the
+  // pool, so it is stopped but not freed, and stays in place so that no new
+  // pool is started.
+  if (BackgroundCompiler *Compiler = Background.load()) {
+    Compiler->shutdown();
+  }
+}
+
 // Notification from the runtime that any caches should be cleaned up.
 void LLILCJit::clearCache() { return; }
 
@@ -905,65 +1290,22 @@ const DWARFDebugInfoEntryMinimal *ObjectLoadListener::getSubprogramDIE(
 
 ICorDebugInfo::RegNum
 ObjectLoadListener::mapDwarfRegisterToRegNum(uint8_t DwarfRegister) {
-  ICorDebugInfo::RegNum Register = ICorDebugInfo::REGNUM_COUNT;
-#if _TARGET_AMD64_
-  switch (DwarfRegister) {
-  case dwarf::DW_OP_reg0:
-    Register = ICorDebugInfo::REGNUM_RAX;
-    break;
-  case dwarf::DW_OP_reg1:
-    Register = ICorDebugInfo::REGNUM_RDX;
-    break;
-  case dwarf::DW_OP_reg2:
-    Register = ICorDebugInfo::REGNUM_RCX;
-    break;
-  case dwarf::DW_OP_reg3:
-    Register = ICorDebugInfo::REGNUM_RBX;
-    break;
-  case dwarf::DW_OP_reg4:
-    Register = ICorDebugInfo::REGNUM_RSI;
-    break;
-  case dwarf::DW_OP_reg5:
-    Register = ICorDebugInfo::REGNUM_RDI;
-    break;
-  case dwarf::DW_OP_reg6:
-    Register = ICorDebugInfo::REGNUM_RBP;
-    break;
-  case dwarf::DW_OP_reg7:
-    Register = ICorDebugInfo::REGNUM_RSP;
-    break;
-  case dwarf::DW_OP_reg8:
-    Register = ICorDebugInfo::REGNUM_R8;
-    break;
-  case dwarf::DW_OP_reg9:
-    Register = ICorDebugInfo::REGNUM_R9;
-    break;
-  case dwarf::DW_OP_reg10:
-    Register = ICorDebugInfo::REGNUM_R10;
-    break;
-  case dwarf::DW_OP_reg11:
-    Register = ICorDebugInfo::REGNUM_R11;
-    break;
-  case dwarf::DW_OP_reg12:
-    Register = ICorDebugInfo::REGNUM_R12;
-    break;
-  case dwarf::DW_OP_reg13:
-    Register = ICorDebugInfo::REGNUM_R13;
-    break;
-  case dwarf::DW_OP_reg14:
-    Register = ICorDebugInfo::REGNUM_R14;
-    break;
-  case dwarf::DW_OP_reg15:
-    Register = ICorDebugInfo::REGNUM_R15;
-    break;
-  default:
-    Register = ICorDebugInfo::REGNUM_COUNT;
-    break;
+  // The frame base is described by a DW_OP_reg<n> location expression.
+  if ((DwarfRegister < dwarf::DW_OP_reg0) ||
+      (DwarfRegister > dwarf::DW_OP_reg31)) {
+    return ICorDebugInfo::REGNUM_COUNT;
   }
-#endif
-  return Register;
+  return GcInfo::mapDwarfRegisterToRegNum(DwarfRegister - dwarf::DW_OP_reg0);
 }
 
 unsigned LLILCJit::getMaxIntrinsicSIMDVectorLength(DWORD CpuCompileFlags) {
-  return getLLILCJitContext()->Options->PreferredIntrinsicSIMDVectorLength;
+  LLILCJitPerThreadState *PerThreadState = State.get();
+  if ((PerThreadState != nullptr) && (PerThreadState->JitContext != nullptr)) {
+    return getLLILCJitContext()->Options->PreferredIntrinsicSIMDVectorLength;
+  }
+
+  // The EE may ask before any method has been jitted on this thread.
+  StringMap<bool> Features;
+  getHostFeatures(CpuCompileFlags, Features);
+  return getSIMDVectorLength(Features);
 }
@@ -0,0 +1,434 @@
+//===---- lib/Jit/RangeCheckElimination.cpp ---------------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Removal of array range checks that are implied by loop bounds and
+/// other dominating conditions.
+///
+//===----------------------------------------------------------------------===//
+
+#include "RangeCheckElimination.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+namespace {
+
+/// \brief A strict less-than relation between two integers.
+struct LessThan {
+  Value *Less;    ///< The smaller value, with extensions stripped.
+  Value *Greater; ///< The larger value, with extensions stripped.
+  bool IsSigned;  ///< Whether the relation holds as signed integers.
+};
+
+typedef SmallVector<LessThan, 8> FactList;
+
+class RangeCheckElimination : public FunctionPass {
+public:
+  static char ID;
+
+  RangeCheckElimination(RangeCheckStatistics *Statistics)
+      : FunctionPass(ID), Statistics(Statistics), DT(nullptr), LI(nullptr) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  /// Collect the relations known to hold on entry to \p Block.
+  void collectFacts(BasicBlock *Block, FactList &Facts);
+
+  /// Collect the relations known to hold on the edge from \p From to \p To.
+  void collectEdgeFacts(BasicBlock *From, BasicBlock *To, FactList &Facts);
+
+  /// Check whether \p Index is known to be in range for \p Array in
+  /// \p Block.
+  bool isInBounds(Value *Index, Value *Array, BasicBlock *Block);
+
+  /// \brief Check whether \p Phi, a loop induction variable, is in range for
+  /// \p Array everywhere it is used.
+  ///
+  /// This holds if the variable is in range on entry to the loop, and each
+  /// back edge passes the variable plus one and is only taken while that
+  /// value is still in range.
+  bool isInductionInBounds(PHINode *Phi, Value *Array);
+
+  /// Check whether \p V is known to be non-negative.
+  bool isNonNegative(Value *V, SmallPtrSetImpl<PHINode *> &Visited);
+
+  RangeCheckStatistics *Statistics;
+  DominatorTree *DT;
+  LoopInfo *LI;
+};
+
+} // namespace
+
+char RangeCheckElimination::ID = 0;
+
+/// Field of the reader's array types that holds the length.
+static const unsigned ArrayLengthFieldIndex = 1;
+
+/// \brief Strip a sign or zero extension from \p V.
+///
+/// \param V               The value to strip.
+/// \param [out] IsZeroExt Set if a zero extension was stripped.
+/// \param [out] IsSignExt Set if a sign extension was stripped.
+/// \returns The value that was extended, or \p V.
+static Value *stripExtension(Value *V, bool &IsZeroExt, bool &IsSignExt) {
+  IsZeroExt = isa<ZExtInst>(V);
+  IsSignExt = isa<SExtInst>(V);
+  if (IsZeroExt || IsSignExt) {
+    return cast<CastInst>(V)->getOperand(0);
+  }
+  return V;
+}
+
+/// \brief Get the array whose length \p V is.
+///
+/// \returns The array, if \p V is a load of the length field of one of the
+/// reader's array types, and nullptr otherwise.
+static Value *getLengthArray(Value *V) {
+  LoadInst *Load = dyn_cast<LoadInst>(V);
+  if (Load == nullptr) {
+    return nullptr;
+  }
+  GEPOperator *Address = dyn_cast<GEPOperator>(Load->getPointerOperand());
+  if ((Address == nullptr) || (Address->getNumIndices() != 2)) {
+    return nullptr;
+  }
+  ConstantInt *Index0 = dyn_cast<ConstantInt>(Address->getOperand(1));
+  ConstantInt *Index1 = dyn_cast<ConstantInt>(Address->getOperand(2));
+  if ((Index0 == nullptr) || !Index0->isZero() || (Index1 == nullptr) ||
+      (Index1->getZExtValue() != ArrayLengthFieldIndex)) {
+    return nullptr;
+  }
+
+  // The reader models arrays as a struct ending with the elements.
+  StructType *ArrayTy = dyn_cast<StructType>(
+      Address->getPointerOperandType()->getPointerElementType());
+  if ((ArrayTy == nullptr) || (ArrayTy->getNumElements() == 0) ||
+      !ArrayTy->getElementType(ArrayTy->getNumElements() - 1)->isArrayTy()) {
+    return nullptr;
+  }
+  return Address->getPointerOperand()->stripPointerCasts();
+}
+
+/// Check whether \p V is \p Phi plus one.
+static bool isIncrementOf(Value *V, PHINode *Phi) {
+  BinaryOperator *Add = dyn_cast<BinaryOperator>(V);
+  if ((Add == nullptr) || (Add->getOpcode() != Instruction::Add)) {
+    return false;
+  }
+  Value *Other;
+  if (Add->getOperand(0) == Phi) {
+    Other = Add->getOperand(1);
+  } else if (Add->getOperand(1) == Phi) {
+    Other = Add->getOperand(0);
+  } else {
+    return false;
+  }
+  ConstantInt *Step = dyn_cast<ConstantInt>(Other);
+  return (Step != nullptr) && Step->isOne();
+}
+
+/// Record the relations implied by \p Condition having the value \p IsTrue.
+static void addFacts(Value *Condition, bool IsTrue, FactList &Facts) {
+  if (BinaryOperator *Logical = dyn_cast<BinaryOperator>(Condition)) {
+    // Both operands of a true conjunction are true, and both operands of a
+    // false disjunction are false.
+    if ((IsTrue && (Logical->getOpcode() == Instruction::And)) ||
+        (!IsTrue && (Logical->getOpcode() == Instruction::Or))) {
+      addFacts(Logical->getOperand(0), IsTrue, Facts);
+      addFacts(Logical->getOperand(1), IsTrue, Facts);
+    }
+    return;
+  }
+
+  ICmpInst *Compare = dyn_cast<ICmpInst>(Condition);
+  if (Compare == nullptr) {
+    return;
+  }
+  CmpInst::Predicate Predicate =
+      IsTrue ? Compare->getPredicate() : Compare->getInversePredicate();
+  Value *Less;
+  Value *Greater;
+  switch (Predicate) {
+  case CmpInst::ICMP_ULT:
+  case CmpInst::ICMP_SLT:
+    Less = Compare->getOperand(0);
+    Greater = Compare->getOperand(1);
+    break;
+  case CmpInst::ICMP_UGT:
+  case CmpInst::ICMP_SGT:
+    Less = Compare->getOperand(1);
+    Greater = Compare->getOperand(0);
+    break;
+  default:
+    return;
+  }
+
+  // Sign extension preserves both the signed and the unsigned order of the
+  // narrow values. Zero extension maps their unsigned order to both orders.
+  bool IsSigned = CmpInst::isSigned(Predicate);
+  bool IsLessZeroExt, IsLessSignExt, IsGreaterZeroExt, IsGreaterSignExt;
+  Less = stripExtension(Less, IsLessZeroExt, IsLessSignExt);
+  Greater = stripExtension(Greater, IsGreaterZeroExt, IsGreaterSignExt);
+  if ((IsLessZeroExt != IsGreaterZeroExt) ||
+      (IsLessSignExt != IsGreaterSignExt) ||
+      (Less->getType() != Greater->getType())) {
+    return;
+  }
+  if (IsLessZeroExt) {
+    IsSigned = false;
+  }
+  Facts.push_back({Less, Greater, IsSigned});
+}
+
+/// \brief Check whether \p Facts show that \p Index is less than the length
+/// of \p Array.
+///
+/// Lengths are non-negative, so a signed relation is only enough if
+/// \p Index is known to be non-negative.
+static bool hasLessThanLength(const FactList &Facts, Value *Index,
+                              Value *Array, bool IsIndexNonNegative) {
+  for (const LessThan &Fact : Facts) {
+    if ((Fact.Less == Index) && (getLengthArray(Fact.Greater) == Array) &&
+        (!Fact.IsSigned || IsIndexNonNegative)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RangeCheckElimination::collectFacts(BasicBlock *Block, FactList &Facts) {
+  DomTreeNode *Node = DT->getNode(Block);
+  if (Node == nullptr) {
+    return;
+  }
+  for (Node = Node->getIDom(); Node != nullptr; Node = Node->getIDom()) {
+    BasicBlock *Dominator = Node->getBlock();
+    BranchInst *Branch = dyn_cast<BranchInst>(Dominator->getTerminator());
+    if ((Branch == nullptr) || !Branch->isConditional()) {
+      continue;
+    }
+    for (unsigned I = 0; I < 2; ++I) {
+      BasicBlockEdge Edge(Dominator, Branch->getSuccessor(I));
+      if (Edge.isSingleEdge() && DT->dominates(Edge, Block)) {
+        addFacts(Branch->getCondition(), I == 0, Facts);
+      }
+    }
+  }
+}
+
+void RangeCheckElimination::collectEdgeFacts(BasicBlock *From, BasicBlock *To,
+                                             FactList &Facts) {
+  BranchInst *Branch = dyn_cast<BranchInst>(From->getTerminator());
+  if ((Branch != nullptr) && Branch->isConditional() &&
+      (Branch->getSuccessor(0) != Branch->getSuccessor(1))) {
+    addFacts(Branch->getCondition(), Branch->getSuccessor(0) == To, Facts);
+  }
+  collectFacts(From, Facts);
+}
+
+bool RangeCheckElimination::isNonNegative(Value *V,
+                                          SmallPtrSetImpl<PHINode *> &Visited) {
+  if (ConstantInt *Constant = dyn_cast<ConstantInt>(V)) {
+    return !Constant->isNegative();
+  }
+  if (isa<ZExtInst>(V) || (getLengthArray(V) != nullptr)) {
+    return true;
+  }
+  if (BinaryOperator *And = dyn_cast<BinaryOperator>(V)) {
+    if (And->getOpcode() == Instruction::And) {
+      ConstantInt *Mask = dyn_cast<ConstantInt>(And->getOperand(1));
+      return (Mask != nullptr) && !Mask->isNegative();
+    }
+    return false;
+  }
+
+  PHINode *Phi = dyn_cast<PHINode>(V);
+  if (Phi == nullptr) {
+    return false;
+  }
+  if (!Visited.insert(Phi).second) {
+    // Give up on cycles other than the increment of an induction variable.
+    return false;
+  }
+
+  Loop *L = LI->getLoopFor(Phi->getParent());
+  bool IsHeader = (L != nullptr) && (L->getHeader() == Phi->getParent());
+  for (unsigned I = 0; I < Phi->getNumIncomingValues(); ++I) {
+    Value *Incoming = Phi->getIncomingValue(I);
+    BasicBlock *Predecessor = Phi->getIncomingBlock(I);
+    if (IsHeader && L->contains(Predecessor) && isIncrementOf(Incoming, Phi)) {
+      // Assuming the variable is non-negative at the top of the loop, the
+      // increment can't make it negative if it only happens while the
+      // variable is less than something.
+      FactList Facts;
+      collectFacts(cast<Instruction>(Incoming)->getParent(), Facts);
+      bool IsBounded = false;
+      for (const LessThan &Fact : Facts) {
+        if ((Fact.Less == Phi) &&
+            (Fact.IsSigned || isNonNegative(Fact.Greater, Visited))) {
+          IsBounded = true;
+          break;
+        }
+      }
+      if (!IsBounded) {
+        return false;
+      }
+      continue;
+    }
+    if (!isNonNegative(Incoming, Visited)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool RangeCheckElimination::isInductionInBounds(PHINode *Phi, Value *Array) {
+  Loop *L = LI->getLoopFor(Phi->getParent());
+  if ((L == nullptr) || (L->getHeader() != Phi->getParent()) ||
+      !L->isLoopInvariant(Array)) {
+    return false;
+  }
+
+  for (unsigned I = 0; I < Phi->getNumIncomingValues(); ++I) {
+    Value *Incoming = Phi->getIncomingValue(I);
+    BasicBlock *Predecessor = Phi->getIncomingBlock(I);
+    FactList Facts;
+    collectEdgeFacts(Predecessor, Phi->getParent(), Facts);
+    if (L->contains(Predecessor)) {
+      // The variable is in range at the top of the loop, and the array
+      // length is at most the largest signed value, so adding one yields a
+      // positive value.
+      if (!isIncrementOf(Incoming, Phi) ||
+          !hasLessThanLength(Facts, Incoming, Array, true)) {
+        return false;
+      }
+    } else {
+      SmallPtrSet<PHINode *, 4> Visited;
+      if (!isNonNegative(Incoming, Visited) ||
+          !hasLessThanLength(Facts, Incoming, Array, true)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool RangeCheckElimination::isInBounds(Value *Index, Value *Array,
+                                       BasicBlock *Block) {
+  FactList Facts;
+  collectFacts(Block, Facts);
+  SmallPtrSet<PHINode *, 4> Visited;
+  bool IsIndexNonNegative = isNonNegative(Index, Visited);
+  if (hasLessThanLength(Facts, Index, Array, IsIndexNonNegative)) {
+    return true;
+  }
+
+  PHINode *Phi = dyn_cast<PHINode>(Index);
+  return (Phi != nullptr) && isInductionInBounds(Phi, Array);
+}
+
+bool RangeCheckElimination::runOnFunction(Function &F) {
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  unsigned RangeCheckKind =
+      F.getContext().getMDKindID(RANGE_CHECK_METADATA_NAME);
+
+  // Decide about every check before rewriting any of them, so that a check
+  // can still be used to prove the checks it dominates.
+  SmallVector<std::pair<BranchInst *, bool>, 8> RedundantChecks;
+  for (BasicBlock &Block : F) {
+    BranchInst *Branch = dyn_cast<BranchInst>(Block.getTerminator());
+    if ((Branch == nullptr) || !Branch->isConditional() ||
+        (Branch->getMetadata(RangeCheckKind) == nullptr)) {
+      continue;
+    }
+    ++Statistics->NumChecks;
+
+    // The optimizer may have inverted the branch, so find the throw by
+    // looking for the successor that doesn't return.
+    unsigned ThrowIndex;
+    if (isa<UnreachableInst>(Branch->getSuccessor(0)->getTerminator())) {
+      ThrowIndex = 0;
+    } else if (isa<UnreachableInst>(
+                   Branch->getSuccessor(1)->getTerminator())) {
+      ThrowIndex = 1;
+    } else {
+      continue;
+    }
+
+    // Find the index and the length from the condition for not throwing.
+    ICmpInst *Compare = dyn_cast<ICmpInst>(Branch->getCondition());
+    if (Compare == nullptr) {
+      continue;
+    }
+    CmpInst::Predicate Predicate = (ThrowIndex == 0)
+                                       ? Compare->getInversePredicate()
+                                       : Compare->getPredicate();
+    Value *Index;
+    Value *Length;
+    if (Predicate == CmpInst::ICMP_ULT) {
+      Index = Compare->getOperand(0);
+      Length = Compare->getOperand(1);
+    } else if (Predicate == CmpInst::ICMP_UGT) {
+      Index = Compare->getOperand(1);
+      Length = Compare->getOperand(0);
+    } else {
+      continue;
+    }
+
+    // Lengths are non-negative, so comparing the unextended values gives
+    // the same result whichever extension was used.
+    bool IsZeroExt, IsSignExt;
+    Index = stripExtension(Index, IsZeroExt, IsSignExt);
+    Length = stripExtension(Length, IsZeroExt, IsSignExt);
+    Value *Array = getLengthArray(Length);
+    if ((Array == nullptr) || (Index->getType() != Length->getType())) {
+      continue;
+    }
+
+    if (isInBounds(Index, Array, &Block)) {
+      RedundantChecks.push_back(std::make_pair(Branch, ThrowIndex != 0));
+    }
+  }
+
+  for (auto &Check : RedundantChecks) {
+    BranchInst *Branch = Check.first;
+    Value *Condition = Branch->getCondition();
+    Branch->setCondition(
+        ConstantInt::get(Type::getInt1Ty(F.getContext()), Check.second));
+    RecursivelyDeleteTriviallyDeadInstructions(Condition);
+  }
+  Statistics->NumRemoved += RedundantChecks.size();
+
+  return !RedundantChecks.empty();
+}
+
+FunctionPass *
+createRangeCheckEliminationPass(RangeCheckStatistics *Statistics) {
+  return new RangeCheckElimination(Statistics);
+}
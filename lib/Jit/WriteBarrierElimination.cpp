@@ -0,0 +1,159 @@
+//===---- lib/Jit/WriteBarrierElimination.cpp -------------------*- C++ -*-===//
+//
+// LLILC
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Replacement of unnecessary write barriers with plain stores.
+///
+//===----------------------------------------------------------------------===//
+
+#include "earlyincludes.h"
+#include "jitpch.h"
+#include "readerir.h"
+#include "WriteBarrierElimination.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+
+namespace {
+
+class WriteBarrierElimination : public FunctionPass {
+public:
+  static char ID;
+
+  WriteBarrierElimination(WriteBarrierStatistics *Statistics)
+      : FunctionPass(ID), Statistics(Statistics) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  WriteBarrierStatistics *Statistics;
+};
+
+} // anonymous namespace
+
+char WriteBarrierElimination::ID = 0;
+
+/// Check whether \p Helper is one of the write barrier helpers.
+static bool isWriteBarrier(CorInfoHelpFunc Helper) {
+  return (Helper == CORINFO_HELP_ASSIGN_REF) ||
+         (Helper == CORINFO_HELP_CHECKED_ASSIGN_REF);
+}
+
+/// Find the object or stack slot that \p Address points into.
+static Value *getBaseAddress(Value *Address) {
+  while (Operator *Op = dyn_cast<Operator>(Address)) {
+    unsigned Opcode = Op->getOpcode();
+    if ((Opcode != Instruction::GetElementPtr) &&
+        (Opcode != Instruction::BitCast) &&
+        (Opcode != Instruction::AddrSpaceCast)) {
+      break;
+    }
+    Address = Op->getOperand(0);
+  }
+  return Address;
+}
+
+/// \brief Check whether \p Base is an object allocated by the fast allocation
+/// helper with no possible GC between the allocation and \p Barrier.
+///
+/// The fast helper only allocates small objects, which start out in the
+/// youngest generation. Code is only interruptible at calls, so the object
+/// stays there until the next call that is not a GC leaf.
+static bool isNewObject(Value *Base, Instruction *Barrier) {
+  CallInst *Allocation = dyn_cast<CallInst>(Base);
+  if (Allocation == nullptr) {
+    return false;
+  }
+  CorInfoHelpFunc Helper = getHelperCallId(Allocation);
+  if ((Helper != CORINFO_HELP_NEWSFAST) &&
+      (Helper != CORINFO_HELP_NEWSFAST_ALIGN8)) {
+    return false;
+  }
+  if (Allocation->getParent() != Barrier->getParent()) {
+    return false;
+  }
+
+  // The allocation dominates the barrier, so it comes first in the block.
+  for (BasicBlock::iterator I = std::next(Allocation->getIterator());
+       &*I != Barrier; ++I) {
+    CallSite Call(&*I);
+    if (!Call || isa<IntrinsicInst>(&*I) ||
+        isWriteBarrier(getHelperCallId(&*I))) {
+      continue;
+    }
+    if (!Call.getAttributes().hasAttribute(AttributeSet::FunctionIndex,
+                                           "gc-leaf-function")) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WriteBarrierElimination::runOnFunction(Function &F) {
+  SmallVector<CallInst *, 8> Unneeded;
+  for (BasicBlock &Block : F) {
+    for (Instruction &Instr : Block) {
+      CorInfoHelpFunc Helper = getHelperCallId(&Instr);
+      if (!isWriteBarrier(Helper)) {
+        continue;
+      }
+      ++Statistics->NumBarriers;
+      if (Helper == CORINFO_HELP_CHECKED_ASSIGN_REF) {
+        ++Statistics->NumChecked;
+      }
+
+      // Barriers that may throw into a handler are left alone, so that
+      // the flow graph doesn't change.
+      CallInst *Barrier = dyn_cast<CallInst>(&Instr);
+      if (Barrier == nullptr) {
+        continue;
+      }
+
+      Value *Address = Barrier->getArgOperand(0);
+      Value *Reference = Barrier->getArgOperand(1);
+      Value *Base = getBaseAddress(Address);
+      if (isa<ConstantPointerNull>(Reference->stripPointerCasts()) ||
+          isa<AllocaInst>(Base) || isNewObject(Base, Barrier)) {
+        Unneeded.push_back(Barrier);
+      }
+    }
+  }
+
+  for (CallInst *Barrier : Unneeded) {
+    IRBuilder<> Builder(Barrier);
+    Value *Address = Barrier->getArgOperand(0);
+    Value *Reference = Barrier->getArgOperand(1);
+    unsigned AddressSpace = Address->getType()->getPointerAddressSpace();
+    Type *AddressTy = PointerType::get(Reference->getType(), AddressSpace);
+    Address = Builder.CreatePointerCast(Address, AddressTy);
+    Builder.CreateStore(Reference, Address);
+    Barrier->eraseFromParent();
+  }
+  Statistics->NumRemoved += Unneeded.size();
+
+  return !Unneeded.empty();
+}
+
+FunctionPass *
+createWriteBarrierEliminationPass(WriteBarrierStatistics *Statistics) {
+  return new WriteBarrierElimination(Statistics);
+}
@@ -19,6 +19,9 @@
 #include "jitpch.h"
 #include "LLILCJit.h"
 #include "jitoptions.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include <algorithm>
+#include <cstdlib>
 
 // Define a macro for cross-platform UTF-16 string literals.
 #if defined(_MSC_VER)
@@ -66,6 +69,21 @@ JitOptions::JitOptions(LLILCJitContext &Context) {
   OptLevel = queryOptLevel(Context);
   EnableOptimization = OptLevel != ::OptLevel::DEBUG_CODE;
 
+  // Set whether to run the mid-level IR optimizer.
+  DoIROptimization = queryDoIROptimization(Context, OptLevel);
+
+  // Set whether to inline callees in the reader.
+  DoInlining = queryDoInlining(Context, OptLevel);
+
+  // Set whether to call the likely target of virtual calls directly.
+  DoGuardedDevirt = queryDoGuardedDevirt(Context, OptLevel);
+
+  // Set whether null checks may be folded into the access they guard.
+  DoImplicitNullCheck = queryDoImplicitNullCheck(Context, OptLevel);
+
+  // Set whether objects that don't escape may be allocated on the stack.
+  DoStackAllocation = queryDoStackAllocation(Context, OptLevel);
+
   // Set whether to use conservative GC.
   UseConservativeGC = queryUseConservativeGC(Context);
 
@@ -87,11 +105,32 @@ JitOptions::JitOptions(LLILCJitContext &Context) {
   IsMSILDumpMethod = queryIsMSILDumpMethod(Context);
   IsLLVMDumpMethod = queryIsLLVMDumpMethod(Context);
   IsCodeRangeMethod = queryIsCodeRangeMethod(Context);
+  ObjectCachePath = queryObjectCachePath(Context);
+  BackgroundThreads = queryBackgroundThreads(Context);
+  TimeLogPath = queryTimeLogPath(Context);
+
+  // Set the CPU and subtarget features to generate code for.
+  llvm::StringMap<bool> Features;
+  queryTarget(Context, TargetCPU, Features);
+  std::vector<std::string> FeatureList;
+  for (const llvm::StringMapEntry<bool> &Feature : Features) {
+    FeatureList.push_back((Feature.getValue() ? "+" : "-") +
+                          Feature.getKey().str());
+  }
+  // Sort the list so that equal feature sets give equal strings, which key
+  // the target machine and object caches.
+  std::sort(FeatureList.begin(), FeatureList.end());
+  llvm::SubtargetFeatures FeatureString;
+  for (const std::string &Feature : FeatureList) {
+    FeatureString.AddFeature(Feature);
+  }
+  TargetFeatures = FeatureString.getString();
 
   if (IsAltJit) {
     PreferredIntrinsicSIMDVectorLength = 0;
   } else {
-    PreferredIntrinsicSIMDVectorLength = 32;
+    PreferredIntrinsicSIMDVectorLength =
+        LLILCJit::getSIMDVectorLength(Features);
   }
 
   // Validate Statepoint and Conservative GC state.
@@ -267,16 +306,148 @@ bool JitOptions::queryExecuteHandlers(LLILCJitContext &Context) {
 
 // Determine if SIMD intrinsics should be used.
 bool JitOptions::queryDoSIMDIntrinsic(LLILCJitContext &Context) {
+  return !queryNonNullNonEmpty(
+      Context, (const char16_t *)UTF16("DisableSIMDIntrinsic"));
+}
+
+// Determine if the mid-level IR optimization passes should be run.
+bool JitOptions::queryDoIROptimization(LLILCJitContext &Context,
+                                       ::OptLevel Level) {
+  if (Level == ::OptLevel::DEBUG_CODE) {
+    return false;
+  }
+  return !queryNonNullNonEmpty(
+      Context, (const char16_t *)UTF16("DisableIROptimization"));
+}
+
+// Determine if the reader should inline callees. Inlining across version
+// bubbles is not supported for ReadyToRun code.
+bool JitOptions::queryDoInlining(LLILCJitContext &Context, ::OptLevel Level) {
+  if ((Level == ::OptLevel::DEBUG_CODE) ||
+      ((Context.Flags & CORJIT_FLG_READYTORUN) != 0)) {
+    return false;
+  }
+  return !queryNonNullNonEmpty(Context,
+                               (const char16_t *)UTF16("DisableInlining"));
+}
+
+// Determine if the reader should guard virtual calls with a class check.
+// This is off unless requested, since without profile data the likely class
+// is only a guess.
+bool JitOptions::queryDoGuardedDevirt(LLILCJitContext &Context,
+                                      ::OptLevel Level) {
+  if ((Level == ::OptLevel::DEBUG_CODE) ||
+      ((Context.Flags & CORJIT_FLG_READYTORUN) != 0)) {
+    return false;
+  }
+  return queryNonNullNonEmpty(
+      Context, (const char16_t *)UTF16("JitGuardedDevirtualization"));
+}
+
+bool JitOptions::queryDoImplicitNullCheck(LLILCJitContext &Context,
+                                          ::OptLevel Level) {
+  if (Level == ::OptLevel::DEBUG_CODE) {
+    return false;
+  }
+  return queryNonNullNonEmpty(
+      Context, (const char16_t *)UTF16("JitImplicitNullChecks"));
+}
+
+bool JitOptions::queryDoStackAllocation(LLILCJitContext &Context,
+                                        ::OptLevel Level) {
+  if ((Level == ::OptLevel::DEBUG_CODE) ||
+      ((Context.Flags & CORJIT_FLG_READYTORUN) != 0)) {
+    return false;
+  }
   return queryNonNullNonEmpty(Context,
-                              (const char16_t *)UTF16("SIMDINTRINSIC"));
+                              (const char16_t *)UTF16("JitStackAllocation"));
+}
+
+std::string JitOptions::queryObjectCachePath(LLILCJitContext &Context) {
+  std::string Path;
+  char16_t *PathStr =
+      getStringConfigValue(Context.JitInfo, UTF16("LLILCObjectCache"));
+  if (PathStr != nullptr) {
+    Path = *Convert::utf16ToUtf8(PathStr);
+    freeStringConfigValue(Context.JitInfo, PathStr);
+  }
+  return Path;
+}
+
+unsigned JitOptions::queryBackgroundThreads(LLILCJitContext &Context) {
+  unsigned NumThreads = 0;
+  char16_t *ThreadsStr =
+      getStringConfigValue(Context.JitInfo, UTF16("LLILCBackgroundJit"));
+  if (ThreadsStr != nullptr) {
+    std::unique_ptr<std::string> Threads = Convert::utf16ToUtf8(ThreadsStr);
+    NumThreads = std::strtoul(Threads->c_str(), nullptr, 10);
+    freeStringConfigValue(Context.JitInfo, ThreadsStr);
+  }
+  return NumThreads;
+}
+
+std::string JitOptions::queryTimeLogPath(LLILCJitContext &Context) {
+  std::string Path;
+  char16_t *PathStr =
+      getStringConfigValue(Context.JitInfo, UTF16("LLILCTimeLog"));
+  if (PathStr != nullptr) {
+    Path = *Convert::utf16ToUtf8(PathStr);
+    freeStringConfigValue(Context.JitInfo, PathStr);
+  }
+  return Path;
+}
+
+void JitOptions::queryTarget(LLILCJitContext &Context, std::string &CPU,
+                             llvm::StringMap<bool> &Features) {
+  // Prejitted code must run on any machine, so it starts from the baseline
+  // of the target. Jitted code starts from the host.
+  CPU.clear();
+  Features.clear();
+  bool IsPrejit =
+      (Context.Flags & (CORJIT_FLG_PREJIT | CORJIT_FLG_READYTORUN)) != 0;
+
+  char16_t *CPUStr =
+      getStringConfigValue(Context.JitInfo, UTF16("LLILCTargetCPU"));
+  if (CPUStr != nullptr) {
+    // An explicit CPU brings its own features.
+    CPU = *Convert::utf16ToUtf8(CPUStr);
+    freeStringConfigValue(Context.JitInfo, CPUStr);
+  } else if (!IsPrejit) {
+    CPU = LLILCJit::TheJit->getHostCPU();
+    LLILCJit::TheJit->getHostFeatures(Context.Flags, Features);
+  }
+
+  char16_t *FeaturesStr =
+      getStringConfigValue(Context.JitInfo, UTF16("LLILCTargetFeatures"));
+  if (FeaturesStr != nullptr) {
+    std::unique_ptr<std::string> Overrides = Convert::utf16ToUtf8(FeaturesStr);
+    freeStringConfigValue(Context.JitInfo, FeaturesStr);
+    llvm::SmallVector<llvm::StringRef, 8> Items;
+    llvm::StringRef(*Overrides).split(Items, ',', -1, false);
+    for (llvm::StringRef Item : Items) {
+      Item = Item.trim();
+      bool Enable = !Item.startswith("-");
+      if (Item.startswith("+") || Item.startswith("-")) {
+        Item = Item.drop_front();
+      }
+      if (!Item.empty()) {
+        Features[Item] = Enable;
+      }
+    }
+  }
 }
 
 OptLevel JitOptions::queryOptLevel(LLILCJitContext &Context) {
   ::OptLevel JitOptLevel = ::OptLevel::BLENDED_CODE;
-  // Currently we only check for the debug flag but this will be extended
-  // to account for further opt levels as we move forward.
-  if ((Context.Flags & CORJIT_FLG_DEBUG_CODE) != 0) {
+  // Debug and MinOpts requests both get unoptimized code, so MinOpts is
+  // folded into DEBUG_CODE rather than having a level of its own. Otherwise
+  // honor any size/speed preference the EE expressed.
+  if ((Context.Flags & (CORJIT_FLG_DEBUG_CODE | CORJIT_FLG_MIN_OPT)) != 0) {
     JitOptLevel = ::OptLevel::DEBUG_CODE;
+  } else if ((Context.Flags & CORJIT_FLG_SIZE_OPT) != 0) {
+    JitOptLevel = ::OptLevel::SMALL_CODE;
+  } else if ((Context.Flags & CORJIT_FLG_SPEED_OPT) != 0) {
+    JitOptLevel = ::OptLevel::FAST_CODE;
   }
 
   return JitOptLevel;
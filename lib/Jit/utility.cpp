@@ -1,6 +1,8 @@
 // Utility code
 
 #include <cstdlib>
+#include <cstddef>
+#include <cstring>
 
 #include "global.h"
 #include "jitpch.h"
@@ -152,6 +154,23 @@ bool MethodSet::contains(const char *MethodName, const char *ClassName,
   return false;
 }
 
+void *ArenaAllocator::allocate(size_t NumBytes) {
+  // Callers expect calloc semantics.
+  void *Memory = Allocator.Allocate(NumBytes, alignof(std::max_align_t));
+  memset(Memory, 0, NumBytes);
+  TotalBytesAllocated += NumBytes;
+  return Memory;
+}
+
+void ArenaAllocator::reset() {
+  // Destroy objects in the reverse order of their registration.
+  for (auto I = Destructors.rbegin(), E = Destructors.rend(); I != E; ++I) {
+    I->first(I->second);
+  }
+  Destructors.clear();
+  Allocator.Reset();
+}
+
 unique_ptr<std::string> Convert::utf16ToUtf8(const char16_t *WideStr) {
   // Get the length of the input
   size_t SrcLen = 0;
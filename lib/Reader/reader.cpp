@@ -2858,6 +2858,58 @@ FlowGraphNode *ReaderBase::fgBuildBasicBlocksFromBytes(uint8_t *Buffer,
   return fgGetHeadBlock();
 }
 
+void ReaderBase::insertIBCAnnotations() {
+  bool Instrument = (Flags & CORJIT_FLG_BBINSTR) != 0;
+  bool UseProfile = (Flags & CORJIT_FLG_BBOPT) != 0;
+  if (!Instrument && !UseProfile) {
+    return;
+  }
+
+  std::vector<FlowGraphNode *> Blocks;
+  for (FlowGraphNode *Block = fgGetHeadBlock(); Block != nullptr;
+       Block = fgNodeGetNext(Block)) {
+    if (fgNodeGetStartMSILOffset(Block) < fgNodeGetEndMSILOffset(Block)) {
+      Blocks.push_back(Block);
+    }
+  }
+  if (Blocks.empty()) {
+    return;
+  }
+
+  ICorJitInfo::ProfileBuffer *Buffer;
+  if (Instrument) {
+    uint32_t NumBlocks = Blocks.size();
+    if (FAILED(JitInfo->allocBBProfileBuffer(NumBlocks, &Buffer))) {
+      return;
+    }
+    static_assert(sizeof(Buffer->ExecutionCount) == sizeof(uint32_t),
+                  "block counters are 32 bits");
+    for (uint32_t I = 0; I < NumBlocks; ++I) {
+      Buffer[I].ILOffset = fgNodeGetStartMSILOffset(Blocks[I]);
+      Buffer[I].ExecutionCount = 0;
+      insertIBCCounter(Blocks[I], (uint32_t *)&Buffer[I].ExecutionCount);
+    }
+    return;
+  }
+
+  ULONG NumEntries;
+  ULONG NumRuns;
+  if (FAILED(JitInfo->getBBProfileData(MethodBeingCompiled, &NumEntries,
+                                       &Buffer, &NumRuns))) {
+    return;
+  }
+  std::map<uint32_t, uint32_t> CountAtOffset;
+  for (ULONG I = 0; I < NumEntries; ++I) {
+    CountAtOffset[Buffer[I].ILOffset] = Buffer[I].ExecutionCount;
+  }
+  for (FlowGraphNode *Block : Blocks) {
+    auto Entry = CountAtOffset.find(fgNodeGetStartMSILOffset(Block));
+    if (Entry != CountAtOffset.end()) {
+      insertIBCAnnotation(Block, Entry->second);
+    }
+  }
+}
+
 // Given information about how to do a runtime lookup, generate the
 // tree for the runtime lookup.
 //
@@ -3397,7 +3449,13 @@ void ReaderBase::insertClassConstructor() {
       const bool MayThrow = false;
       callHelper(HelperId, MayThrow, nullptr, ClassNode);
     } else {
-      rdrCallGetStaticBase(Class, MethodToken, HelperId, false, false, nullptr);
+      // The constructor of a beforefieldinit class may run early, so the
+      // call can be hoisted and commoned.
+      const bool NoCtor = false;
+      bool CanMoveUp =
+          (getClassAttribs(Class) & CORINFO_FLG_BEFOREFIELDINIT) != 0;
+      rdrCallGetStaticBase(Class, MethodToken, HelperId, NoCtor, CanMoveUp,
+                           nullptr);
     }
   }
 }
@@ -3613,6 +3671,12 @@ void ReaderBase::rdrCallWriteBarrierHelper(
     IRNode *Dst, IRNode *Src, ReaderAlignType Alignment, bool IsVolatile,
     CORINFO_RESOLVED_TOKEN *ResolvedToken, bool IsNotValueClass,
     bool IsValueIsPointer, bool IsFieldToken, bool IsUnchecked) {
+  // The checked barrier first checks whether the destination is in the GC
+  // heap, which is unnecessary when it is known to be within an object.
+  if (!IsUnchecked && isHeapAddress(Dst)) {
+    IsUnchecked = true;
+  }
+
   if (IsNotValueClass) {
     // This is the non-value class case.  That is, we are simply
     // writing to a field in a class which happens to be a GC pointer.
@@ -4311,8 +4375,36 @@ ReaderBase::rdrCall(ReaderCallTargetData *Data, ReaderBaseNS::CallOpcode Opcode,
           break;
 
         case CORINFO_INTRINSIC_Sin:
-          break;
         case CORINFO_INTRINSIC_Cos:
+        case CORINFO_INTRINSIC_Exp:
+        case CORINFO_INTRINSIC_Log10:
+        case CORINFO_INTRINSIC_Round:
+        case CORINFO_INTRINSIC_Ceiling:
+        case CORINFO_INTRINSIC_Floor:
+          IntrinsicArg1 = (IRNode *)ReaderOperandStack->pop();
+
+          if (mathIntrinsic(IntrinsicID, IntrinsicArg1, &IntrinsicRet))
+            return IntrinsicRet;
+
+          ReaderOperandStack->push(IntrinsicArg1);
+          CallCanSideEffect = false;
+          MayThrow = false;
+          break;
+
+        case CORINFO_INTRINSIC_Cosh:
+        case CORINFO_INTRINSIC_Sinh:
+        case CORINFO_INTRINSIC_Tan:
+        case CORINFO_INTRINSIC_Tanh:
+        case CORINFO_INTRINSIC_Asin:
+        case CORINFO_INTRINSIC_Acos:
+        case CORINFO_INTRINSIC_Atan:
+        case CORINFO_INTRINSIC_Atan2:
+        case CORINFO_INTRINSIC_Pow:
+          // These stay calls to the runtime's implementation, which differs
+          // from the C library for some special values. The calls are pure,
+          // which the client can use to optimize them.
+          CallCanSideEffect = false;
+          MayThrow = false;
           break;
 
         case CORINFO_INTRINSIC_Sqrt:
@@ -4391,9 +4483,6 @@ ReaderBase::rdrCall(ReaderCallTargetData *Data, ReaderBaseNS::CallOpcode Opcode,
           }
           break;
 
-        case CORINFO_INTRINSIC_Round:
-          break;
-
         case CORINFO_INTRINSIC_StringLength:
           IntrinsicArg1 = (IRNode *)ReaderOperandStack->pop();
 
@@ -4787,8 +4876,12 @@ ReaderBase::rdrCall(ReaderCallTargetData *Data, ReaderBaseNS::CallOpcode Opcode,
 
   // Get the call target
   if (!Data->isCallI()) {
-    rdrMakeCallTargetNode(Data,
-                          Arguments.size() == 0 ? nullptr : &Arguments[0]);
+    IRNode **ThisPtr = Arguments.size() == 0 ? nullptr : &Arguments[0];
+    rdrDevirtualizeCall(Data, ThisPtr);
+    // For guarded calls the client generates the target on the slow path.
+    if (Data->getGuardClass() == nullptr) {
+      rdrMakeCallTargetNode(Data, ThisPtr);
+    }
     ASSERT(!Data->isNewObj() || Arguments[0] == NewObjThisArg);
   }
 
@@ -4812,6 +4905,65 @@ bool ReaderBase::rdrCallIsDelegateInvoke(ReaderCallTargetData *CallTargetData) {
   return false;
 }
 
+void ReaderBase::rdrDevirtualizeCall(ReaderCallTargetData *CallTargetData,
+                                     IRNode **ThisPtr) {
+  CORINFO_CALL_INFO *CallInfo = CallTargetData->getCallInfo();
+  if ((CallInfo == nullptr) || (ThisPtr == nullptr) ||
+      !CallTargetData->hasThis() || CallTargetData->isNewObj() ||
+      CallTargetData->isJmp() || rdrCallIsDelegateInvoke(CallTargetData)) {
+    return;
+  }
+
+  // Only calls dispatched through the method table or a stub are
+  // candidates. Generic virtual methods are looked up at runtime and
+  // are left alone.
+  if ((CallInfo->kind != CORINFO_VIRTUALCALL_VTABLE) &&
+      (CallInfo->kind != CORINFO_VIRTUALCALL_STUB)) {
+    return;
+  }
+
+  // ReadyToRun code may not bind to a method's entry point directly.
+  if ((Flags & CORJIT_FLG_READYTORUN) != 0) {
+    return;
+  }
+
+  CORINFO_METHOD_HANDLE Method = CallTargetData->getMethodHandle();
+  uint32_t MethodAttribs = CallTargetData->getMethodAttribs();
+  if ((MethodAttribs & (CORINFO_FLG_ABSTRACT | CORINFO_FLG_SHAREDINST)) != 0) {
+    return;
+  }
+
+  // The target is only known for objects of the class that declares it;
+  // without help from the EE an override in a subclass, or the method that
+  // implements an interface method, can't be found.
+  CORINFO_CLASS_HANDLE Class = getMethodClass(Method);
+  uint32_t ClassAttribs = getClassAttribs(Class);
+  if ((ClassAttribs & (CORINFO_FLG_INTERFACE | CORINFO_FLG_ABSTRACT |
+                       CORINFO_FLG_SHAREDINST)) != 0) {
+    return;
+  }
+
+  if (getExactThisClass(*ThisPtr) == Class) {
+    // The object's class is known exactly, so this is a direct call. The
+    // object is known to be non-null as well.
+    CallInfo->kind = CORINFO_CALL;
+    CallInfo->nullInstanceCheck = FALSE;
+    return;
+  }
+
+  // Otherwise bet on the declaring class. Tail calls are left alone since
+  // the check would have to be made in the callee's frame.
+  if (!doGuardedDevirtualization() || CallTargetData->isTailCall() ||
+      !canInlineTypeCheckWithObjectVTable(Class)) {
+    return;
+  }
+
+  // The object's method table is loaded to check the guard, so the object
+  // has to be null checked first, as it would be for a stub dispatch.
+  CallTargetData->GuardClass = Class;
+  CallTargetData->NeedsNullCheck = true;
+}
+
 void ReaderBase::rdrMakeCallTargetNode(ReaderCallTargetData *CallTargetData,
                                        IRNode **ThisPtr) {
   CORINFO_CALL_INFO *CallInfo = CallTargetData->getCallInfo();
@@ -7235,14 +7387,9 @@ void ReaderBase::readBytesForFlowGraphNode(FlowGraphNode *Fg,
     // stack for this block, verify that the current stack is empty.
     ReaderStack *Temp = fgNodeGetOperandStack(Fg);
     if (Temp) {
-      // If we are going to switch stacks make sure to clean up the active
-      // stack -- any important state was propagated to the successors
-      // already.
-      if (ReaderOperandStack != Temp) {
-        if (ReaderOperandStack != nullptr) {
-          delete ReaderOperandStack;
-        }
-      }
+      // Switch to a copy of the block's stack. Any important state on the
+      // active stack was propagated to the successors already, and its
+      // memory is reclaimed along with the rest of the temp memory.
       ReaderOperandStack = Temp->copy();
     } else {
       ReaderOperandStack->assertEmpty();
@@ -7497,7 +7644,6 @@ void ReaderBase::msilToIR(void) {
     // Pop top block
     FlowGraphNode *Block = Worklist->Block;
     FlowGraphNodeWorkList *Next = Worklist->Next;
-    delete Worklist;
     // Prepend unvisited successors to worklist
     Worklist = fgPrependUnvisitedSuccToWorklist(Next, Block);
   }
@@ -7622,45 +7768,16 @@ void ReaderBase::msilToIR(void) {
   //
   readerPostPass(IsImportOnly);
 
-  // Cleanup memory used
-  for (uint32_t Index = 0; Index < NodeOffsetListArraySize; Index++) {
-    FlowGraphNodeOffsetList *Element = NodeOffsetListArray[Index];
-    while (Element != nullptr) {
-      FlowGraphNodeOffsetList *NextElement = Element->getNext();
-      delete Element;
-      Element = NextElement;
-    }
-  }
-  delete NodeOffsetListArray;
-
+  // Operand stacks, node offset lists and EH regions were obtained from
+  // getTempMemory/getProcMemory and are released in bulk by the client, so
+  // just drop our references to them here.
+  NodeOffsetListArray = nullptr;
   for (FlowGraphNode *Block = FgHead; Block != nullptr;
        Block = fgNodeGetNext(Block)) {
-    ReaderStack *Stack = fgNodeGetOperandStack(Block);
-    if (Stack != nullptr) {
-      delete Stack;
-      fgNodeSetOperandStack(Block, nullptr);
-    }
-  }
-
-  if (ReaderOperandStack != nullptr) {
-    delete ReaderOperandStack;
-    ReaderOperandStack = nullptr;
-  }
-
-  EHRegionList *RegionList = AllRegionList;
-  while (RegionList != nullptr) {
-    EHRegionList *Next = rgnListGetNext(RegionList);
-    EHRegion *Region = rgnListGetRgn(RegionList);
-    EHRegionList *Children = rgnGetChildList(Region);
-    while (Children != nullptr) {
-      EHRegionList *NextChild = rgnListGetNext(Children);
-      free(Children);
-      Children = NextChild;
-    }
-    free(RegionList);
-    free(Region);
-    RegionList = Next;
+    fgNodeSetOperandStack(Block, nullptr);
   }
+  ReaderOperandStack = nullptr;
+  AllRegionList = nullptr;
 }
 
 bool ReaderBase::fgNodeHasMultiplePredsPropagatingStack(FlowGraphNode *Node) {
@@ -8115,6 +8232,7 @@ void ReaderCallTargetData::init(
   this->TargetMethodHandleNode = nullptr;
   this->IndirectionCellNode = nullptr;
   this->CallTargetNode = nullptr;
+  this->GuardClass = nullptr;
 
   // fill CALL_INFO, SIG_INFO, METHOD_HANDLE, METHOD_ATTRIBS
   fillTargetInfo(TargetToken, ConstraintToken, Context, Scope, Caller,
@@ -8228,7 +8346,8 @@ void ReaderBase::resolveToken(mdToken Token, CorInfoTokenKind TokenType,
 //===----------------------------------------------------------------------===//
 
 IRNode *ReaderBase::generateSIMDBinOp(ReaderSIMDIntrinsic OperationCode,
-                                      CORINFO_CLASS_HANDLE Class) {
+                                      CORINFO_CLASS_HANDLE Class,
+                                      CORINFO_SIG_INFO *SigInfo) {
   IRNode *Arg2 = ReaderOperandStack->pop();
   IRNode *Arg1 = ReaderOperandStack->pop();
   if (isVectorType(Arg1) && isVectorType(Arg2)) {
@@ -8267,6 +8386,27 @@ IRNode *ReaderBase::generateSIMDBinOp(ReaderSIMDIntrinsic OperationCode,
     case BITEXOR:
       ReturnNode = vectorBitExOr(Vector1, Vector2, VectorByteSize);
       break;
+    case ANDNOT:
+      ReturnNode = vectorAndNot(Vector1, Vector2);
+      break;
+    case EQ:
+    case NEQ:
+      ReturnNode = vectorAllEqual(Vector1, Vector2, OperationCode == NEQ);
+      break;
+    case GT:
+    case GE:
+    case LT:
+    case LE:
+    case EQMASK:
+      ReturnNode = vectorCompare(OperationCode, Vector1, Vector2, IsSigned,
+                                 SigInfo->retTypeClass);
+      break;
+    case DOT:
+      ReturnNode = vectorDot(Vector1, Vector2, SigInfo->retType);
+      break;
+    case NARROW:
+      ReturnNode = vectorNarrow(Vector1, Vector2);
+      break;
     default:
       break;
     }
@@ -8280,7 +8420,9 @@ IRNode *ReaderBase::generateSIMDBinOp(ReaderSIMDIntrinsic OperationCode,
   return 0;
 }
 
-IRNode *ReaderBase::generateSIMDUnOp(ReaderSIMDIntrinsic OperationCode) {
+IRNode *ReaderBase::generateSIMDUnOp(ReaderSIMDIntrinsic OperationCode,
+                                     CORINFO_CLASS_HANDLE Class,
+                                     CORINFO_SIG_INFO *SigInfo) {
   IRNode *Arg = ReaderOperandStack->pop();
   if (isVectorType(Arg)) {
     IRNode *Vector = Arg;
@@ -8292,6 +8434,16 @@ IRNode *ReaderBase::generateSIMDUnOp(ReaderSIMDIntrinsic OperationCode) {
     case SQRT:
       ReturnNode = vectorSqrt(Vector);
       break;
+    case NEG:
+      ReturnNode = vectorNeg(Vector);
+      break;
+    case NOT:
+      ReturnNode = vectorNot(Vector);
+      break;
+    case CONVERT:
+      ReturnNode =
+          vectorConvert(Vector, getIsSigned(Class), SigInfo->retTypeClass);
+      break;
     default:
       break;
     }
@@ -8304,6 +8456,58 @@ IRNode *ReaderBase::generateSIMDUnOp(ReaderSIMDIntrinsic OperationCode) {
   return 0;
 }
 
+IRNode *ReaderBase::generateSIMDConditionalSelect() {
+  IRNode *Vector2 = ReaderOperandStack->pop();
+  IRNode *Vector1 = ReaderOperandStack->pop();
+  IRNode *Mask = ReaderOperandStack->pop();
+  if (isVectorType(Mask) && isVectorType(Vector1) && isVectorType(Vector2)) {
+    IRNode *ReturnNode = vectorConditionalSelect(Mask, Vector1, Vector2);
+    if (ReturnNode) {
+      return ReturnNode;
+    }
+  }
+  ReaderOperandStack->push(Mask);
+  ReaderOperandStack->push(Vector1);
+  ReaderOperandStack->push(Vector2);
+  return 0;
+}
+
+IRNode *ReaderBase::generateSIMDWiden(CORINFO_CLASS_HANDLE Class) {
+  IRNode *HighPointer = ReaderOperandStack->pop();
+  IRNode *LowPointer = ReaderOperandStack->pop();
+  IRNode *Vector = ReaderOperandStack->pop();
+  if (isVectorType(Vector)) {
+    IRNode *ReturnNode =
+        vectorWiden(Vector, LowPointer, HighPointer, getIsSigned(Class));
+    if (ReturnNode) {
+      return ReturnNode;
+    }
+  }
+  ReaderOperandStack->push(Vector);
+  ReaderOperandStack->push(LowPointer);
+  ReaderOperandStack->push(HighPointer);
+  return 0;
+}
+
+IRNode *ReaderBase::generateSIMDCopyTo(int ArgsCount) {
+  IRNode *Index = nullptr;
+  if (ArgsCount == 2) {
+    Index = ReaderOperandStack->pop();
+  }
+  IRNode *Array = ReaderOperandStack->pop();
+  IRNode *VectorPointer = ReaderOperandStack->pop();
+  IRNode *ReturnNode = vectorCopyTo(VectorPointer, Array, Index);
+  if (ReturnNode) {
+    return ReturnNode;
+  }
+  ReaderOperandStack->push(VectorPointer);
+  ReaderOperandStack->push(Array);
+  if (Index != nullptr) {
+    ReaderOperandStack->push(Index);
+  }
+  return 0;
+}
+
 IRNode *ReaderBase::generateSIMDIntrinsicCall(CORINFO_CLASS_HANDLE Class,
                                               CORINFO_METHOD_HANDLE Method,
                                               CORINFO_SIG_INFO *SigInfo,
@@ -8319,13 +8523,17 @@ IRNode *ReaderBase::generateSIMDIntrinsicCall(CORINFO_CLASS_HANDLE Class,
   ReaderSIMDIntrinsic OperationType = UNDEF;
   if (!strcmp(MethodName, ".ctor")) {
     OperationType = CTOR;
-  } else if (!strcmp(MethodName, "op_Addition")) {
+  } else if (!strcmp(MethodName, "op_Addition") ||
+             !strcmp(MethodName, "Add")) {
     OperationType = ADD;
-  } else if (!strcmp(MethodName, "op_Subtraction")) {
+  } else if (!strcmp(MethodName, "op_Subtraction") ||
+             !strcmp(MethodName, "Subtract")) {
     OperationType = SUB;
-  } else if (!strcmp(MethodName, "op_Multiply")) {
+  } else if (!strcmp(MethodName, "op_Multiply") ||
+             !strcmp(MethodName, "Multiply")) {
     OperationType = MUL;
-  } else if (!strcmp(MethodName, "op_Division")) {
+  } else if (!strcmp(MethodName, "op_Division") ||
+             !strcmp(MethodName, "Divide")) {
     OperationType = DIV;
   } else if (!strcmp(MethodName, "Min")) {
     OperationType = MIN;
@@ -8335,11 +8543,14 @@ IRNode *ReaderBase::generateSIMDIntrinsicCall(CORINFO_CLASS_HANDLE Class,
     OperationType = EQ;
   } else if (!strcmp(MethodName, "op_Inequality")) {
     OperationType = NEQ;
-  } else if (!strcmp(MethodName, "op_BitwiseOr")) {
+  } else if (!strcmp(MethodName, "op_BitwiseOr") ||
+             !strcmp(MethodName, "BitwiseOr")) {
     OperationType = BITOR;
-  } else if (!strcmp(MethodName, "op_BitwiseAnd")) {
+  } else if (!strcmp(MethodName, "op_BitwiseAnd") ||
+             !strcmp(MethodName, "BitwiseAnd")) {
     OperationType = BITAND;
-  } else if (!strcmp(MethodName, "op_ExclusiveOr")) {
+  } else if (!strcmp(MethodName, "op_ExclusiveOr") ||
+             !strcmp(MethodName, "Xor")) {
     OperationType = BITEXOR;
   } else if (!strcmp(MethodName, "Abs")) {
     OperationType = ABS;
@@ -8349,9 +8560,52 @@ IRNode *ReaderBase::generateSIMDIntrinsicCall(CORINFO_CLASS_HANDLE Class,
     OperationType = GETCOUNTOP;
   } else if (!strcmp(MethodName, "get_Item")) {
     OperationType = GETITEM;
+  } else if (!strcmp(MethodName, "op_UnaryNegation") ||
+             !strcmp(MethodName, "Negate")) {
+    OperationType = NEG;
+  } else if (!strcmp(MethodName, "op_OnesComplement") ||
+             !strcmp(MethodName, "OnesComplement")) {
+    OperationType = NOT;
+  } else if (!strcmp(MethodName, "AndNot")) {
+    OperationType = ANDNOT;
+  } else if (!strcmp(MethodName, "GreaterThan")) {
+    OperationType = GT;
+  } else if (!strcmp(MethodName, "GreaterThanOrEqual")) {
+    OperationType = GE;
+  } else if (!strcmp(MethodName, "LessThan")) {
+    OperationType = LT;
+  } else if (!strcmp(MethodName, "LessThanOrEqual")) {
+    OperationType = LE;
+  } else if (!strcmp(MethodName, "Equals") && !SigInfo->hasThis()) {
+    // The static Vector.Equals returns a mask. The instance Equals methods
+    // return bool and are left to the managed implementation.
+    OperationType = EQMASK;
+  } else if (!strcmp(MethodName, "ConditionalSelect")) {
+    OperationType = CONDSELECT;
+  } else if (!strcmp(MethodName, "Dot")) {
+    OperationType = DOT;
+  } else if (!strcmp(MethodName, "Widen")) {
+    OperationType = WIDEN;
+  } else if (!strcmp(MethodName, "Narrow")) {
+    OperationType = NARROW;
+  } else if (!strncmp(MethodName, "ConvertTo", 9)) {
+    OperationType = CONVERT;
+  } else if (!strcmp(MethodName, "CopyTo")) {
+    OperationType = COPYTO;
   }
   CorInfoType ResType = SigInfo->retType;
 
+  // The static methods of System.Numerics.Vector are generic over the
+  // element type, so take the vector class from the first argument.
+  CORINFO_CLASS_HANDLE VectorClass = Class;
+  if ((getElementCountOfSIMDType(Class) == 0) && (SigInfo->numArgs > 0)) {
+    CORINFO_CLASS_HANDLE ArgClass = nullptr;
+    argListNext(SigInfo->args, SigInfo, nullptr, &ArgClass);
+    if (ArgClass != nullptr) {
+      VectorClass = ArgClass;
+    }
+  }
+
   switch (OperationType) {
   case ADD:
   case SUB:
@@ -8362,11 +8616,36 @@ IRNode *ReaderBase::generateSIMDIntrinsicCall(CORINFO_CLASS_HANDLE Class,
   case BITOR:
   case BITAND:
   case BITEXOR:
-    ReturnNode = generateSIMDBinOp(OperationType, Class);
+  case ANDNOT:
+  case EQ:
+  case NEQ:
+  case GT:
+  case GE:
+  case LT:
+  case LE:
+  case EQMASK:
+  case DOT:
+  case NARROW:
+    ReturnNode = generateSIMDBinOp(OperationType, VectorClass, SigInfo);
     break;
   case ABS:
   case SQRT:
-    ReturnNode = generateSIMDUnOp(OperationType);
+  case NEG:
+  case NOT:
+  case CONVERT:
+    ReturnNode = generateSIMDUnOp(OperationType, VectorClass, SigInfo);
+    break;
+  case CONDSELECT:
+    assert(SigInfo->numArgs == 3);
+    ReturnNode = generateSIMDConditionalSelect();
+    break;
+  case WIDEN:
+    assert(SigInfo->numArgs == 3);
+    ReturnNode = generateSIMDWiden(VectorClass);
+    break;
+  case COPYTO:
+    assert(SigInfo->hasThis());
+    ReturnNode = generateSIMDCopyTo(SigInfo->numArgs);
     break;
   case CTOR:
     assert(SigInfo->numArgs <= ReaderOperandStack->size());
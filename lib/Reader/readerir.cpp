@@ -17,19 +17,27 @@
 #include "readerir.h"
 #include "imeta.h"
 #include "newvstate.h"
+#include "HelperCallMotion.h"
+#include "RangeCheckElimination.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/Support/Debug.h"            // for dbgs()
 #include "llvm/Support/Format.h"           // for format()
+#include "llvm/Support/MathExtras.h"       // for MinAlign(), isPowerOf2_32()
 #include "llvm/Support/raw_ostream.h"      // for errs()
+#include "llvm/Target/TargetLowering.h"    // for isOperationLegal()
+#include "llvm/Target/TargetSubtargetInfo.h"
 #include "llvm/Support/ConvertUTF.h"       // for ConvertUTF16toUTF8
 #include "llvm/Transforms/Utils/Cloning.h" // for CloneBasicBlock/RemapInstr
 #include "llvm/Transforms/Utils/Local.h"   // for removeUnreachableBlocks
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/DebugInfoMetadata.h"
+#include <atomic>
 #include <cstdlib>
 #include <new>
 
@@ -81,8 +89,7 @@ void GenStack::print() {
 #endif
 
 ReaderStack *GenStack::copy() {
-  void *Buffer = Reader->getTempMemory(sizeof(GenStack));
-  GenStack *Copy = new (Buffer) GenStack(Stack.capacity(), Reader);
+  ReaderStack *Copy = Reader->createStack();
   for (auto Value : *this) {
     Copy->push(Value);
   }
@@ -91,7 +98,11 @@ ReaderStack *GenStack::copy() {
 
 ReaderStack *GenIR::createStack() {
   void *Buffer = getTempMemory(sizeof(GenStack));
-  return new (Buffer) GenStack(4, this);
+  GenStack *Stack = new (Buffer) GenStack(4, this);
+  // The stack's storage lives on the heap, so it must be destroyed before
+  // the temp arena is reset.
+  JitContext->TempArena.registerDestructor(Stack);
+  return Stack;
 }
 
 #pragma endregion
@@ -132,14 +143,12 @@ public:
 };
 
 EHRegion *GenIR::rgnAllocateRegion() {
-  // TODO: Using ProcMemory here.
-  // Do we really want these Region objects to persist?
+  // Regions live in ProcMemory, which is released once the jit request
+  // completes.
   return (EHRegion *)getProcMemory(sizeof(EHRegion));
 }
 
 EHRegionList *GenIR::rgnAllocateRegionList() {
-  // TODO: Using ProcMemory here.
-  // Do we really want these Region objects to persist?
   return (EHRegionList *)getProcMemory(sizeof(EHRegionList));
 }
 
@@ -245,11 +254,15 @@ EHRegion *rgnGetEntryRegion(EHRegion *TryRegion) {
 //===----------------------------------------------------------------------===//
 
 // Get memory that will be freed at end of reader
+void *GenIR::getTempMemory(size_t NumBytes) {
+  return JitContext->TempArena.allocate(NumBytes);
+}
 
-void *GenIR::getTempMemory(size_t NumBytes) { return calloc(1, NumBytes); }
-
-// Get memory that will persist after the reader
-void *GenIR::getProcMemory(size_t NumBytes) { return calloc(1, NumBytes); }
+// Get memory that will persist after the reader, until the end of the
+// jit request.
+void *GenIR::getProcMemory(size_t NumBytes) {
+  return JitContext->ProcArena.allocate(NumBytes);
+}
 
 #pragma endregion
 
@@ -801,8 +814,98 @@ void GenIR::markGCLeaf(CallSite Call) {
   Call.setAttributes(Attrs);
 }
 
+void GenIR::applyBlockProfile() {
+  LLVMContext &Context = *JitContext->LLVMContext;
+
+  // The counters live in memory the EE allocated for the method, so their
+  // increments are ordinary non-atomic read-modify-writes.
+  Type *CounterTy = Type::getInt32Ty(Context);
+  Type *CounterPtrTy = getUnmanagedPointerType(CounterTy);
+  for (auto &Entry : IBCCounters) {
+    // The block may have been deleted as unreachable.
+    BasicBlock *Block = cast_or_null<BasicBlock>((Value *)Entry.first);
+    if ((Block == nullptr) || (Block->getFirstInsertionPt() == Block->end())) {
+      continue;
+    }
+    LLVMBuilder->SetInsertPoint(Block, Block->getFirstInsertionPt());
+    const bool IsIndirect = false;
+    const bool IsReadOnly = false;
+    const bool IsRelocatable = true;
+    const bool IsCallTarget = false;
+    Value *Address = (Value *)handleToIRNode(mdtIBCProfHandle, Entry.second, 0,
+                                             IsIndirect, IsReadOnly,
+                                             IsRelocatable, IsCallTarget);
+    Value *Counter = LLVMBuilder->CreateIntToPtr(Address, CounterPtrTy);
+    Value *Count = LLVMBuilder->CreateLoad(Counter);
+    Value *One = ConstantInt::get(CounterTy, 1);
+    LLVMBuilder->CreateStore(LLVMBuilder->CreateAdd(Count, One), Counter);
+  }
+
+  DenseMap<BasicBlock *, uint32_t> Counts;
+  for (auto &Entry : IBCCounts) {
+    BasicBlock *Block = cast_or_null<BasicBlock>((Value *)Entry.first);
+    if (Block != nullptr) {
+      Counts[Block] = Entry.second;
+    }
+  }
+  if (Counts.empty()) {
+    return;
+  }
+
+  auto FirstCount = Counts.find((BasicBlock *)FirstMSILBlock);
+  if (FirstCount != Counts.end()) {
+    Function->setEntryCount(FirstCount->second);
+  }
+
+  // Branches whose weights the reader already set, such as those guarding
+  // throws, are left alone.
+  MDBuilder MDB(Context);
+  for (BasicBlock &Block : *Function) {
+    TerminatorInst *Terminator = Block.getTerminator();
+    if ((Terminator == nullptr) || (Terminator->getNumSuccessors() < 2) ||
+        !(isa<BranchInst>(Terminator) || isa<SwitchInst>(Terminator)) ||
+        (Terminator->getMetadata(LLVMContext::MD_prof) != nullptr)) {
+      continue;
+    }
+    SmallVector<uint32_t, 4> Weights;
+    for (BasicBlock *Successor : successors(&Block)) {
+      auto SuccessorCount = Counts.find(Successor);
+      if (SuccessorCount == Counts.end()) {
+        break;
+      }
+      Weights.push_back(SuccessorCount->second);
+    }
+    if (Weights.size() == Terminator->getNumSuccessors()) {
+      Terminator->setMetadata(LLVMContext::MD_prof,
+                              MDB.createBranchWeights(Weights));
+    }
+  }
+}
+
 void GenIR::readerPostPass(bool IsImportOnly) {
 
+  if (JitContext->IsInlinee) {
+    // The caller zero-initializes the GC allocations it inherits from the
+    // inlinee at the inlined call site, and again along with escaping them
+    // when it finishes its own post pass.
+    delete DBuilder;
+    delete LLVMBuilder;
+    return;
+  }
+
+  // Add the block profile before inlining splits the blocks it refers to.
+  applyBlockProfile();
+
+  // Inline callees now that the caller's IR is complete, so that any GC
+  // allocations brought in from the callees are reported below.
+  inlineCalls();
+
+  // Move objects to the stack now that the calls made on them have been
+  // inlined, and before the GC allocations are escaped and initialized.
+  if (JitContext->Options->DoStackAllocation) {
+    allocateObjectsOnStack();
+  }
+
   SmallVector<Value *, 4> EscapingLocs;
   GcFuncInfo->getEscapingLocations(EscapingLocs);
 
@@ -1234,6 +1337,457 @@ void GenIR::zeroInitLocals() {
 #endif // !NDEBUG
 }
 
+void GenIR::noteInlineCandidate(ReaderCallTargetData *CallTargetInfo,
+                                IRNode *Call) {
+  if (CallTargetInfo->isCallI() || CallTargetInfo->isIndirect() ||
+      (CallTargetInfo->getCallInfo() == nullptr) ||
+      !CallTargetInfo->isTrueDirect() ||
+      CallTargetInfo->isOptimizedDelegateCtor() ||
+      CallTargetInfo->isStubDispatch()) {
+    return;
+  }
+
+  noteInlineCandidate(CallTargetInfo, Call,
+                      CallTargetInfo->getKnownMethodHandle());
+}
+
+void GenIR::noteInlineCandidate(ReaderCallTargetData *CallTargetInfo,
+                                IRNode *Call, CORINFO_METHOD_HANDLE Callee) {
+  if (!JitContext->Options->DoInlining || JitContext->IsInlinee) {
+    return;
+  }
+
+  // Calls inside protected regions are invokes and calls inside handlers
+  // carry funclet bundles; leave both alone.
+  CallInst *CallInstr = dyn_cast<CallInst>(Call);
+  if ((CallInstr == nullptr) || CallInstr->hasOperandBundles()) {
+    return;
+  }
+
+  const ReaderCallSignature &Signature =
+      CallTargetInfo->getCallTargetSignature();
+  if (Signature.getCallingConvention() != CORINFO_CALLCONV_DEFAULT) {
+    return;
+  }
+
+  // Explicit tail calls must not grow the stack, so keep them as calls.
+  if (CallTargetInfo->isTailCall() && !CallTargetInfo->isUnmarkedTailCall()) {
+    return;
+  }
+
+  CorInfoIntrinsics IntrinsicID = CallTargetInfo->getCorInstrinsic();
+  if ((0 <= IntrinsicID) && (IntrinsicID < CORINFO_INTRINSIC_Count)) {
+    return;
+  }
+
+  if ((Callee == nullptr) || (Callee == getCurrentMethodHandle())) {
+    return;
+  }
+
+  InlineCandidates.push_back(std::make_pair(WeakVH(CallInstr), Callee));
+}
+
+void GenIR::inlineCalls() {
+  CORINFO_METHOD_HANDLE Caller = getCurrentMethodHandle();
+  uint32_t NumInlined = 0;
+
+  for (auto &Candidate : InlineCandidates) {
+    // The call may have been deleted along with an unreachable block.
+    CallInst *Call = cast_or_null<CallInst>((Value *)Candidate.first);
+    if (Call == nullptr) {
+      continue;
+    }
+
+    CORINFO_METHOD_HANDLE Callee = Candidate.second;
+    const char *Reason = nullptr;
+    CorInfoInline Result;
+    if (NumInlined >= MaxInlinesPerMethod) {
+      Result = INLINE_FAIL;
+      Reason = "too many inlinees";
+    } else {
+      Result = inlineCall(Call, Callee, Reason);
+    }
+
+    if (Result == INLINE_PASS) {
+      NumInlined++;
+    }
+
+    JitContext->JitInfo->reportInliningDecision(Caller, Callee, Result,
+                                                Reason);
+  }
+
+  InlineCandidates.clear();
+}
+
+// Remove a function created while reading an inlinee, along with the debug
+// info compile unit the inlinee's reader created.
+static void discardInlinee(llvm::Function *Inlinee, GcFuncInfo *InlineeInfo,
+                           DICompileUnit *InlineeCU) {
+  Module *M = Inlinee->getParent();
+  NamedMDNode *CUs = M->getNamedMetadata("llvm.dbg.cu");
+  if ((CUs != nullptr) && (InlineeCU != nullptr)) {
+    SmallVector<MDNode *, 4> KeptCUs;
+    for (MDNode *CU : CUs->operands()) {
+      if (CU != InlineeCU) {
+        KeptCUs.push_back(CU);
+      }
+    }
+    CUs->clearOperands();
+    for (MDNode *CU : KeptCUs) {
+      CUs->addOperand(CU);
+    }
+  }
+
+  delete InlineeInfo;
+  Inlinee->dropAllReferences();
+  Inlinee->eraseFromParent();
+}
+
+CorInfoInline GenIR::inlineCall(CallInst *Call, CORINFO_METHOD_HANDLE Callee,
+                                const char *&Reason) {
+  Reason = nullptr;
+  uint32_t Restrictions = 0;
+  CorInfoInline Result =
+      canInline(getCurrentMethodHandle(), Callee, &Restrictions);
+  if (Result != INLINE_PASS) {
+    Reason = "canInline declined";
+    return Result;
+  }
+
+  CORINFO_METHOD_INFO CalleeInfo;
+  if (Restrictions != 0) {
+    Reason = "inlining restrictions";
+  } else if (!JitContext->JitInfo->getMethodInfo(Callee, &CalleeInfo)) {
+    Reason = "no method info";
+  } else if (CalleeInfo.ILCodeSize > MaxInlineILSize) {
+    Reason = "too many il bytes";
+  } else if (CalleeInfo.EHcount > 0) {
+    Reason = "exception handling";
+  } else if (CalleeInfo.args.isVarArg()) {
+    Reason = "varargs";
+  } else if ((CalleeInfo.options & CORINFO_GENERICS_CTXT_MASK) != 0) {
+    Reason = "generic context";
+  } else if ((getMethodAttribs(Callee) &
+              (CORINFO_FLG_SYNCH | CORINFO_FLG_SECURITYCHECK)) != 0) {
+    Reason = "synchronized or security check";
+  }
+
+  if (Reason != nullptr) {
+    return INLINE_FAIL;
+  }
+
+  // Read the callee into a new function in the current module, using a
+  // nested context so that the callee gets its own reader state.
+  LLILCJitContext InlineeContext(JitContext->State);
+  ::GcInfo InlineeGcInfo;
+  InlineeContext.JitInfo = JitContext->JitInfo;
+  InlineeContext.JitHost = JitContext->JitHost;
+  InlineeContext.MethodInfo = &CalleeInfo;
+  // The block profile belongs to the method being jitted, so the inlinee
+  // neither allocates counters nor looks up counts of its own.
+  InlineeContext.Flags =
+      JitContext->Flags & ~(CORJIT_FLG_PUBLISH_SECRET_PARAM |
+                            CORJIT_FLG_BBINSTR | CORJIT_FLG_BBOPT);
+  InlineeContext.EEInfo = JitContext->EEInfo;
+  InlineeContext.LLVMContext = JitContext->LLVMContext;
+  InlineeContext.CurrentModule = JitContext->CurrentModule;
+  InlineeContext.TM = JitContext->TM;
+  InlineeContext.IsInlinee = true;
+  InlineeContext.TheABIInfo = JitContext->TheABIInfo;
+  InlineeContext.Options = JitContext->Options;
+  InlineeContext.GcInfo = &InlineeGcInfo;
+
+  GenIR InlineeReader(&InlineeContext);
+  try {
+    InlineeReader.msilToIR();
+  } catch (NotYetImplementedException &) {
+    Reason = "inlinee not supported";
+  }
+
+  llvm::Function *Inlinee = InlineeReader.Function;
+  if (Inlinee == nullptr) {
+    return INLINE_FAIL;
+  }
+
+  if (Reason == nullptr) {
+    if (InlineeReader.containsUnmanagedCall() || InlineeReader.HasLocAlloc ||
+        InlineeReader.NeedsSecurityObject ||
+        InlineeReader.KeepGenericContextAlive) {
+      Reason = "unsupported inlinee frame";
+    } else if ((Inlinee->getFunctionType() != Call->getFunctionType()) ||
+               (Inlinee->getCallingConv() != Call->getCallingConv())) {
+      Reason = "signature mismatch";
+    } else if (!Inlinee->use_empty()) {
+      Reason = "recursive";
+    }
+  }
+
+  if (Reason == nullptr) {
+    for (BasicBlock &Block : *Inlinee) {
+      for (Instruction &Instr : Block) {
+        CallInst *InlineeCall = dyn_cast<CallInst>(&Instr);
+        if ((InlineeCall != nullptr) && InlineeCall->isMustTailCall()) {
+          Reason = "jmp";
+        }
+      }
+    }
+  }
+
+  // Only plain GC values can be handed over to the caller's GcFuncInfo.
+  GcFuncInfo *InlineeInfo = InlineeGcInfo.getGcInfo(Inlinee);
+  if (Reason == nullptr) {
+    for (auto &Entry : InlineeInfo->AllocaMap) {
+      if ((Entry.second.Flags & ~AllocaFlags::GcValue) != 0) {
+        Reason = "special gc allocation";
+      }
+    }
+  }
+
+  DICompileUnit *InlineeCU = InlineeReader.LLILCDebugInfo.TheCU;
+  if (Reason != nullptr) {
+    discardInlinee(Inlinee, InlineeInfo, InlineeCU);
+    return INLINE_FAIL;
+  }
+
+  // The inlined code keeps the caller's debug locations.
+  stripDebugInfo(*Inlinee);
+  Inlinee->setLinkage(GlobalValue::InternalLinkage);
+
+  // Mark where the inlined body will start, since the call goes away.
+  Type *MarkerTy = Type::getInt8Ty(*JitContext->LLVMContext);
+  Instruction *Marker =
+      new BitCastInst(UndefValue::get(MarkerTy), MarkerTy, "", Call);
+
+  Value *OriginalTarget = Call->getCalledValue();
+  Call->setCalledFunction(Inlinee);
+  InlineFunctionInfo IFI;
+  const bool InsertLifetime = false;
+  if (!InlineFunction(Call, IFI, nullptr, InsertLifetime)) {
+    Call->setCalledFunction(OriginalTarget);
+    Marker->eraseFromParent();
+    discardInlinee(Inlinee, InlineeInfo, InlineeCU);
+    Reason = "llvm inliner declined";
+    return INLINE_FAIL;
+  }
+
+  // The inlined allocations now live in the caller's entry block, where the
+  // caller's post pass zero-initializes the GC ones along with its own. The
+  // inlined body may run many times, for instance in a loop, so also zero
+  // them each time it starts, as a call to the inlinee would have.
+  LLVMBuilder->SetInsertPoint(Marker);
+  for (AllocaInst *Alloca : IFI.StaticAllocas) {
+    if (GcInfo::isGcAllocation(Alloca)) {
+      GcFuncInfo->recordGcAlloca(Alloca);
+      zeroInit(Alloca);
+    }
+  }
+  Marker->eraseFromParent();
+
+  // The inlined code may refer to handles only the inlinee's reader saw.
+  for (const auto &Entry : InlineeContext.NameToHandleMap) {
+    (*NameToHandleMap)[Entry.getKey()] = Entry.getValue();
+  }
+
+  discardInlinee(Inlinee, InlineeInfo, InlineeCU);
+  return INLINE_PASS;
+}
+
+void GenIR::allocateObjectsOnStack() {
+  LLVMContext &LLVMContext = *JitContext->LLVMContext;
+  const DataLayout &DataLayout = JitContext->CurrentModule->getDataLayout();
+  const uint32_t PointerSize = DataLayout.getPointerSize();
+  Type *HeaderTy = Type::getIntNTy(LLVMContext, TargetPointerSizeInBits);
+
+  // Only the fast helper is considered: the others allocate objects that
+  // are large, finalizable or need extra alignment.
+  SmallVector<CallInst *, 4> Allocations;
+  for (BasicBlock &Block : *Function) {
+    for (Instruction &Instr : Block) {
+      CallInst *Call = dyn_cast<CallInst>(&Instr);
+      if ((Call != nullptr) &&
+          (getHelperCallId(Call) == CORINFO_HELP_NEWSFAST)) {
+        Allocations.push_back(Call);
+      }
+    }
+  }
+
+  for (CallInst *Allocation : Allocations) {
+    Type *ObjectTy = Allocation->getType()->getPointerElementType();
+    if (!ObjectTy->isSized() ||
+        (DataLayout.getTypeAllocSize(ObjectTy) > MaxStackObjectSize)) {
+      continue;
+    }
+
+    // Each object gets a single stack slot, so the allocation must not be
+    // reached again while the object it made may still be referenced.
+    BasicBlock *AllocationBlock = Allocation->getParent();
+    SmallPtrSet<BasicBlock *, 16> Visited;
+    SmallVector<BasicBlock *, 16> Worklist(succ_begin(AllocationBlock),
+                                           succ_end(AllocationBlock));
+    bool IsInCycle = false;
+    while (!Worklist.empty() && !IsInCycle) {
+      BasicBlock *Block = Worklist.pop_back_val();
+      IsInCycle = (Block == AllocationBlock);
+      if (Visited.insert(Block).second) {
+        Worklist.append(succ_begin(Block), succ_end(Block));
+      }
+    }
+    if (IsInCycle) {
+      continue;
+    }
+
+    SmallVector<CallInst *, 4> Barriers;
+    if (doesObjectEscape(Allocation, Barriers)) {
+      continue;
+    }
+
+    // The object header precedes the method table pointer.
+    Type *StackObjectFields[] = {HeaderTy, ObjectTy};
+    StructType *StackObjectTy = StructType::get(LLVMContext, StackObjectFields);
+    if (DataLayout.getStructLayout(StackObjectTy)->getElementOffset(1) !=
+        PointerSize) {
+      continue;
+    }
+
+    // The new slot holds GC pointers if the object does, so it is reported
+    // to the GC like any other GC aggregate on the stack.
+    Instruction *StackObject = createTemporary(StackObjectTy, "StackObject");
+
+    // Initialize the object as the helper would: zero it and store the
+    // method table the helper was passed.
+    LLVMBuilder->SetInsertPoint(Allocation);
+    zeroInitBlock(StackObject, DataLayout.getTypeAllocSize(StackObjectTy));
+    Value *Object =
+        LLVMBuilder->CreateStructGEP(StackObjectTy, StackObject, 1, "Object");
+    Value *MethodTable = Allocation->getArgOperand(0);
+    Value *MethodTableAddress = LLVMBuilder->CreatePointerCast(
+        Object, getUnmanagedPointerType(MethodTable->getType()));
+    LLVMBuilder->CreateStore(MethodTable, MethodTableAddress);
+
+    // The GC ignores references to objects outside the heap, and all
+    // references are reported as interior pointers, so the object can be
+    // referred to by an ordinary GC pointer.
+    Value *ObjectRef = LLVMBuilder->CreateAddrSpaceCast(
+        Object, getManagedPointerType(ObjectTy));
+    ObjectRef = LLVMBuilder->CreatePointerCast(ObjectRef,
+                                               Allocation->getType());
+
+    // Stores into the object don't need to update the card table.
+    for (CallInst *Barrier : Barriers) {
+      LLVMBuilder->SetInsertPoint(Barrier);
+      Value *FieldAddress = Barrier->getArgOperand(0);
+      Value *FieldValue = Barrier->getArgOperand(1);
+      unsigned AddressSpace = FieldAddress->getType()->getPointerAddressSpace();
+      Type *FieldAddressTy =
+          PointerType::get(FieldValue->getType(), AddressSpace);
+      FieldAddress =
+          LLVMBuilder->CreatePointerCast(FieldAddress, FieldAddressTy);
+      LLVMBuilder->CreateStore(FieldValue, FieldAddress);
+      Barrier->eraseFromParent();
+    }
+
+    Allocation->replaceAllUsesWith(ObjectRef);
+    Allocation->eraseFromParent();
+  }
+}
+
+bool GenIR::doesObjectEscape(Instruction *Object,
+                             SmallVectorImpl<CallInst *> &Barriers) {
+  SmallPtrSet<Value *, 16> Visited;
+  SmallVector<Value *, 16> Worklist;
+  Visited.insert(Object);
+  Worklist.push_back(Object);
+
+  auto AddReference = [&](Value *Reference) {
+    if (Visited.insert(Reference).second) {
+      Worklist.push_back(Reference);
+    }
+  };
+
+  while (!Worklist.empty()) {
+    Value *Reference = Worklist.pop_back_val();
+    for (User *U : Reference->users()) {
+      if (isa<LoadInst>(U) || isa<ICmpInst>(U)) {
+        continue;
+      }
+
+      if (isa<BitCastInst>(U) || isa<AddrSpaceCastInst>(U) ||
+          isa<GetElementPtrInst>(U) || isa<PHINode>(U) || isa<SelectInst>(U)) {
+        AddReference(U);
+        continue;
+      }
+
+      if (StoreInst *Store = dyn_cast<StoreInst>(U)) {
+        if (Store->getValueOperand() != Reference) {
+          // Storing into the object.
+          continue;
+        }
+
+        // Storing the reference itself is only allowed into a local that is
+        // simply loaded and stored. The loads then produce references too.
+        AllocaInst *Local = dyn_cast<AllocaInst>(Store->getPointerOperand());
+        if (Local == nullptr) {
+          return true;
+        }
+        for (User *LocalUser : Local->users()) {
+          StoreInst *LocalStore = dyn_cast<StoreInst>(LocalUser);
+          if ((LocalStore != nullptr) &&
+              (LocalStore->getPointerOperand() == Local) &&
+              (LocalStore->getValueOperand() != Local)) {
+            continue;
+          }
+          if (!isa<LoadInst>(LocalUser)) {
+            return true;
+          }
+          AddReference(LocalUser);
+        }
+        continue;
+      }
+
+      CallInst *Call = dyn_cast<CallInst>(U);
+      if (Call == nullptr) {
+        return true;
+      }
+
+      switch (getHelperCallId(Call)) {
+      case CORINFO_HELP_MEMSET:
+        if (Call->getArgOperand(0) == Reference) {
+          continue;
+        }
+        return true;
+      case CORINFO_HELP_MEMCPY:
+        // Copying to or from the object doesn't capture the reference.
+        continue;
+      case CORINFO_HELP_ASSIGN_REF:
+      case CORINFO_HELP_CHECKED_ASSIGN_REF: {
+        // The barrier may only be replaced by a store if the field is known
+        // to be in this object rather than one of several objects.
+        if (Call->getArgOperand(1) == Reference) {
+          return true;
+        }
+        Value *Base = Call->getArgOperand(0);
+        while (isa<BitCastInst>(Base) || isa<AddrSpaceCastInst>(Base) ||
+               isa<GetElementPtrInst>(Base)) {
+          Base = cast<Instruction>(Base)->getOperand(0);
+        }
+        if (Base != Object) {
+          return true;
+        }
+        if (std::find(Barriers.begin(), Barriers.end(), Call) ==
+            Barriers.end()) {
+          Barriers.push_back(Call);
+        }
+        continue;
+      }
+      default:
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
 void GenIR::zeroInitBlock(Value *Address, uint64_t Size) {
   bool IsSigned = false;
   ConstantInt *BlockSize = ConstantInt::get(
@@ -1242,12 +1796,17 @@ void GenIR::zeroInitBlock(Value *Address, uint64_t Size) {
 }
 
 void GenIR::zeroInitBlock(Value *Address, Value *Size) {
-  // TODO: For small structs we may want to generate an integer StoreInst
-  // instead of calling a helper.
   LLVMContext &LLVMContext = *JitContext->LLVMContext;
+  Value *ZeroByte = ConstantInt::get(LLVMContext, APInt(8, 0, true));
+  const bool IsVolatile = false;
+  const bool AddressMayBeNull = false;
+  if (genInlineBlockOp(Address, nullptr, ZeroByte, Size, Reader_AlignUnknown,
+                       IsVolatile, AddressMayBeNull)) {
+    return;
+  }
+
   const bool MayThrow = false;
   Type *VoidTy = Type::getVoidTy(LLVMContext);
-  Value *ZeroByte = ConstantInt::get(LLVMContext, APInt(8, 0, true));
   callHelperImpl(CORINFO_HELP_MEMSET, MayThrow, VoidTy, (IRNode *)Address,
                  (IRNode *)ZeroByte, (IRNode *)Size);
 }
@@ -1255,16 +1814,148 @@ void GenIR::zeroInitBlock(Value *Address, Value *Size) {
 void GenIR::copyStructNoBarrier(Type *StructTy, Value *DestinationAddress,
                                 Value *SourceAddress, bool IsVolatile,
                                 ReaderAlignType Alignment) {
-  // TODO: For small structs we may want to generate an integer StoreInst
-  // instead of calling a helper.
   const DataLayout *DataLayout = &JitContext->CurrentModule->getDataLayout();
   const StructLayout *TheStructLayout =
       DataLayout->getStructLayout(cast<StructType>(StructTy));
   IRNode *StructSize =
       (IRNode *)ConstantInt::get(Type::getInt32Ty(*JitContext->LLVMContext),
                                  TheStructLayout->getSizeInBytes());
-  cpBlk(StructSize, (IRNode *)SourceAddress, (IRNode *)DestinationAddress,
-        Alignment, IsVolatile);
+  const bool AddressMayBeNull = false;
+  if (genInlineBlockOp(DestinationAddress, SourceAddress, nullptr, StructSize,
+                       Alignment, IsVolatile, AddressMayBeNull,
+                       cast<StructType>(StructTy))) {
+    return;
+  }
+  ReaderBase::cpBlk(StructSize, (IRNode *)SourceAddress,
+                    (IRNode *)DestinationAddress, Alignment, IsVolatile);
+}
+
+void GenIR::cpBlk(IRNode *ByteCount, IRNode *SourceAddress,
+                  IRNode *DestinationAddress, ReaderAlignType Alignment,
+                  bool IsVolatile) {
+  const bool AddressMayBeNull = true;
+  if (!genInlineBlockOp(DestinationAddress, SourceAddress, nullptr, ByteCount,
+                        Alignment, IsVolatile, AddressMayBeNull)) {
+    ReaderBase::cpBlk(ByteCount, SourceAddress, DestinationAddress, Alignment,
+                      IsVolatile);
+  }
+}
+
+void GenIR::initBlk(IRNode *NumBytes, IRNode *ValuePerByte,
+                    IRNode *DestinationAddress, ReaderAlignType Alignment,
+                    bool IsVolatile) {
+  const bool AddressMayBeNull = true;
+  if (!genInlineBlockOp(DestinationAddress, nullptr, ValuePerByte, NumBytes,
+                        Alignment, IsVolatile, AddressMayBeNull)) {
+    ReaderBase::initBlk(NumBytes, ValuePerByte, DestinationAddress, Alignment,
+                        IsVolatile);
+  }
+}
+
+bool GenIR::genInlineBlockOp(Value *DestinationAddress, Value *SourceAddress,
+                             Value *FillValue, Value *ByteCount,
+                             ReaderAlignType Alignment, bool IsVolatile,
+                             bool AddressMayBeNull, StructType *StructTy) {
+  // The helpers are left to handle volatile blocks and blocks of unknown or
+  // large size.
+  ConstantInt *Count = dyn_cast<ConstantInt>(ByteCount);
+  if (IsVolatile || (Count == nullptr) ||
+      (Count->getZExtValue() > MaxInlineBlockSize)) {
+    return false;
+  }
+  ConstantInt *Fill = nullptr;
+  if (SourceAddress == nullptr) {
+    Fill = dyn_cast<ConstantInt>(FillValue);
+    if (Fill == nullptr) {
+      return false;
+    }
+  }
+
+  // The helpers don't touch memory for an empty block, so neither do we.
+  uint64_t Size = Count->getZExtValue();
+  if (Size == 0) {
+    return true;
+  }
+
+  LLVMContext &LLVMContext = *JitContext->LLVMContext;
+  Type *ByteTy = Type::getInt8Ty(LLVMContext);
+  auto GetBytePointer = [&](Value *Address) -> Value * {
+    if (!Address->getType()->isPointerTy()) {
+      Address = LLVMBuilder->CreateIntToPtr(Address,
+                                            getUnmanagedPointerType(ByteTy));
+    } else {
+      unsigned AddressSpace = Address->getType()->getPointerAddressSpace();
+      Address = LLVMBuilder->CreatePointerCast(
+          Address, PointerType::get(ByteTy, AddressSpace));
+    }
+    if (AddressMayBeNull && UseExplicitNullChecks) {
+      Address = genNullCheck((IRNode *)Address);
+    }
+    return Address;
+  };
+  auto GetChunkAddress = [&](Value *Address, uint64_t Offset, Type *Ty) {
+    unsigned AddressSpace = Address->getType()->getPointerAddressSpace();
+    Value *ChunkAddress =
+        LLVMBuilder->CreateConstInBoundsGEP1_64(Address, Offset);
+    return LLVMBuilder->CreatePointerCast(ChunkAddress,
+                                          PointerType::get(Ty, AddressSpace));
+  };
+
+  // Copy or fill a pointer-sized chunk at a time, so that any GC references
+  // in the block are moved whole. Where the layout of a copied block is
+  // known, its GC references are moved as GC pointers so that they are
+  // reported while in flight. All the source chunks are loaded before any
+  // is stored, so overlapping blocks are handled the way the helper handles
+  // them.
+  Value *Destination = GetBytePointer(DestinationAddress);
+  Value *Source = (SourceAddress == nullptr) ? nullptr
+                                             : GetBytePointer(SourceAddress);
+  const DataLayout &DataLayout = JitContext->CurrentModule->getDataLayout();
+  SmallVector<uint32_t, 4> GcOffsets;
+  if ((Source != nullptr) && (StructTy != nullptr) &&
+      GcInfo::isGcAggregate(StructTy)) {
+    GcInfo::getGcPointers(StructTy, DataLayout, GcOffsets);
+  }
+  Type *GcPointerTy = getManagedPointerType(ByteTy);
+  // Only an explicit alignment is trusted, like the helper, which assumes
+  // none at all.
+  uint32_t Align = ((Alignment == Reader_AlignNatural) ||
+                    (Alignment == Reader_AlignUnknown))
+                       ? 1
+                       : convertReaderAlignment(Alignment);
+  SmallVector<std::pair<uint64_t, Value *>, 8> Chunks;
+  for (uint64_t Offset = 0; Offset < Size;) {
+    uint32_t Width = getPointerByteSize();
+    while (Width > Size - Offset) {
+      Width /= 2;
+    }
+    Type *ChunkTy = Type::getIntNTy(LLVMContext, Width * 8);
+    if (std::find(GcOffsets.begin(), GcOffsets.end(), Offset) !=
+        GcOffsets.end()) {
+      ChunkTy = GcPointerTy;
+    }
+    uint32_t ChunkAlign = std::min<uint32_t>(Width, MinAlign(Align, Offset));
+    Value *Chunk;
+    if (Source == nullptr) {
+      APInt FillByte(8, Fill->getZExtValue());
+      Chunk = ConstantInt::get(ChunkTy, APInt::getSplat(Width * 8, FillByte));
+    } else {
+      Value *ChunkAddress = GetChunkAddress(Source, Offset, ChunkTy);
+      Chunk = LLVMBuilder->CreateAlignedLoad(ChunkAddress, ChunkAlign);
+    }
+    Chunks.push_back(std::make_pair(Offset, Chunk));
+    Offset += Width;
+  }
+  for (const auto &Chunk : Chunks) {
+    uint64_t Offset = Chunk.first;
+    Value *ChunkAddress =
+        GetChunkAddress(Destination, Offset, Chunk.second->getType());
+    uint32_t Width = DataLayout.getTypeStoreSize(Chunk.second->getType());
+    uint32_t ChunkAlign = std::min<uint32_t>(Width, MinAlign(Align, Offset));
+    LLVMBuilder->CreateAlignedStore(Chunk.second, ChunkAddress, ChunkAlign);
+  }
+
+  return true;
 }
 
 void GenIR::copyStruct(CORINFO_CLASS_HANDLE Class, IRNode *Dst, IRNode *Src,
@@ -1623,6 +2314,10 @@ bool GenIR::doSimdIntrinsicOpt() {
   return JitContext->Options->DoSIMDIntrinsic;
 }
 
+bool GenIR::doGuardedDevirtualization() {
+  return JitContext->Options->DoGuardedDevirt;
+}
+
 #pragma endregion
 
 #pragma region DIAGNOSTICS
@@ -3825,7 +4520,13 @@ void GenIR::fgAddLabelToBranchList(IRNode *LabelNode, IRNode *BranchNode) {
   return;
 }
 
-void GenIR::insertIBCAnnotations() { return; }
+void GenIR::insertIBCCounter(FlowGraphNode *Node, uint32_t *Counter) {
+  IBCCounters.push_back(std::make_pair(WeakVH(Node), Counter));
+}
+
+void GenIR::insertIBCAnnotation(FlowGraphNode *Node, uint32_t Count) {
+  IBCCounts.push_back(std::make_pair(WeakVH(Node), Count));
+}
 
 IRNode *GenIR::fgNodeFindStartLabel(FlowGraphNode *Block) { return nullptr; }
 
@@ -5670,6 +6371,16 @@ IRNode *GenIR::call(ReaderBaseNS::CallOpcode Opcode, mdToken Token,
   return rdrCall(Data, Opcode, &CallNode);
 }
 
+CorInfoHelpFunc getHelperCallId(const Instruction *Call) {
+  MDNode *HelperMD = Call->getMetadata(HELPER_CALL_METADATA_NAME);
+  if (HelperMD == nullptr) {
+    return CORINFO_HELP_UNDEF;
+  }
+  ConstantInt *HelperId =
+      mdconst::extract<ConstantInt>(HelperMD->getOperand(0));
+  return (CorInfoHelpFunc)HelperId->getZExtValue();
+}
+
 bool isNonVolatileWriteHelperCall(CorInfoHelpFunc HelperId) {
   switch (HelperId) {
   case CORINFO_HELP_ASSIGN_REF:
@@ -5810,6 +6521,20 @@ CallSite GenIR::callHelperImpl(CorInfoHelpFunc HelperID, IRNode *Address,
   // transitioning to a valid stack type, if appropriate.
   CallSite Call = makeCall(Target, MayThrow, Arguments);
 
+  // Note which helper is called, so that later passes can recognize it.
+  LLVMContext &LLVMContext = *JitContext->LLVMContext;
+  Metadata *HelperMD = ConstantAsMetadata::get(
+      ConstantInt::get(Type::getInt32Ty(LLVMContext), HelperID));
+  Call.getInstruction()->setMetadata(HELPER_CALL_METADATA_NAME,
+                                     MDNode::get(LLVMContext, HelperMD));
+
+  // Let the optimizer hoist the call out of loops and common it with an
+  // identical call that dominates it.
+  if (CanMoveUp) {
+    Call.getInstruction()->setMetadata(MOVEABLE_HELPER_METADATA_NAME,
+                                       MDNode::get(LLVMContext, None));
+  }
+
   if (IsVolatile && isNonVolatileWriteHelperCall(HelperID)) {
     // TODO: this is only needed where CLRConfig::INTERNAL_JitLockWrite is set
     // For now, conservatively we emit barrier regardless.
@@ -5986,6 +6711,28 @@ CORINFO_CLASS_HANDLE GenIR::inferThisClass(IRNode *ThisArgument) {
   return nullptr;
 }
 
+CORINFO_CLASS_HANDLE GenIR::getExactThisClass(IRNode *ThisArgument) {
+  auto MapElem = ExactClassMap.find((Value *)ThisArgument);
+  if (MapElem != ExactClassMap.end()) {
+    return MapElem->second;
+  }
+  return nullptr;
+}
+
+bool GenIR::isHeapAddress(IRNode *Address) {
+  // Look through the field and element address computations for the
+  // object. Values of reference class type always refer to objects on the
+  // heap; byrefs, which may refer to the stack, have other types.
+  Value *Base = (Value *)Address;
+  while (GEPOperator *GEP = dyn_cast<GEPOperator>(Base)) {
+    Base = GEP->getPointerOperand();
+  }
+  if (Base == (Value *)Address) {
+    return false;
+  }
+  return (ReverseClassTypeMap->count(Base->getType()) != 0);
+}
+
 bool GenIR::canMakeDirectCall(ReaderCallTargetData *CallTargetData) {
   return !CallTargetData->isJmp();
 }
@@ -6231,7 +6978,17 @@ IRNode *GenIR::genNewObjThisArg(ReaderCallTargetData *CallTargetData,
     IRNode *ClassHandleNode = CallTargetData->getClassHandleNode();
     CorInfoHelpFunc HelperId = getNewHelper(CallTargetData->getResolvedToken());
     TheCallSite = callHelperImpl(HelperId, MayThrow, ThisType, ClassHandleNode);
+
+    // Remember the class of the new object so that virtual calls made on it
+    // can be devirtualized. The class is only exact if it was not looked up
+    // at runtime.
+    if (!CallTargetData->getClassHandleNodeRequiresRuntimeLookup() &&
+        ((ClassAttribs & CORINFO_FLG_SHAREDINST) == 0)) {
+      ExactClassMap[TheCallSite.getInstruction()] =
+          CallTargetData->getClassHandle();
+    }
   }
+  setAllocationAttributes(TheCallSite, nullptr);
   Value *ThisPointer = TheCallSite.getInstruction();
   return (IRNode *)ThisPointer;
 }
@@ -6267,10 +7024,7 @@ IRNode *GenIR::genNewObjReturnNode(ReaderCallTargetData *CallTargetData,
   return ThisArg;
 }
 
-IRNode *GenIR::genCall(ReaderCallTargetData *CallTargetInfo, bool MayThrow,
-                       std::vector<IRNode *> Args, IRNode **CallNode) {
-  IRNode *Call = nullptr;
-  IRNode *TargetNode = CallTargetInfo->getCallTargetNode();
+IRNode *GenIR::convertCallTarget(IRNode *TargetNode) {
   if (!isa<llvm::Function>(TargetNode) &&
       TargetNode->getType()->isPointerTy()) {
     // According to the ECMA CLI standard, II.14.5, the preferred
@@ -6284,6 +7038,17 @@ IRNode *GenIR::genCall(ReaderCallTargetData *CallTargetInfo, bool MayThrow,
         Type::getIntNTy(LLVMContext, TargetPointerSizeInBits);
     TargetNode = (IRNode *)LLVMBuilder->CreatePtrToInt(TargetNode, NativeInt);
   }
+  return TargetNode;
+}
+
+IRNode *GenIR::genCall(ReaderCallTargetData *CallTargetInfo, bool MayThrow,
+                       std::vector<IRNode *> Args, IRNode **CallNode) {
+  IRNode *Call = nullptr;
+  IRNode *TargetNode = nullptr;
+  bool IsGuarded = CallTargetInfo->getGuardClass() != nullptr;
+  if (!IsGuarded) {
+    TargetNode = convertCallTarget(CallTargetInfo->getCallTargetNode());
+  }
   const ReaderCallSignature &Signature =
       CallTargetInfo->getCallTargetSignature();
 
@@ -6327,6 +7092,7 @@ IRNode *GenIR::genCall(ReaderCallTargetData *CallTargetInfo, bool MayThrow,
   }
 
   CorInfoIntrinsics IntrinsicID = CallTargetInfo->getCorInstrinsic();
+  bool IsPure = false;
   if ((0 <= IntrinsicID) && (IntrinsicID < CORINFO_INTRINSIC_Count)) {
     switch (IntrinsicID) {
     // TODO: note that these methods have well-known semantics that the jit can
@@ -6340,16 +7106,43 @@ IRNode *GenIR::genCall(ReaderCallTargetData *CallTargetInfo, bool MayThrow,
     case CORINFO_INTRINSIC_GetManagedThreadId: {
       break;
     }
+    // The Math methods that were not expanded inline don't touch memory,
+    // so they can be hoisted and commoned. They are still safepoints: the
+    // call may go through a stub that triggers a GC.
+    case CORINFO_INTRINSIC_Sin:
+    case CORINFO_INTRINSIC_Cos:
+    case CORINFO_INTRINSIC_Exp:
+    case CORINFO_INTRINSIC_Log10:
+    case CORINFO_INTRINSIC_Round:
+    case CORINFO_INTRINSIC_Ceiling:
+    case CORINFO_INTRINSIC_Floor:
+    case CORINFO_INTRINSIC_Cosh:
+    case CORINFO_INTRINSIC_Sinh:
+    case CORINFO_INTRINSIC_Tan:
+    case CORINFO_INTRINSIC_Tanh:
+    case CORINFO_INTRINSIC_Asin:
+    case CORINFO_INTRINSIC_Acos:
+    case CORINFO_INTRINSIC_Atan:
+    case CORINFO_INTRINSIC_Atan2:
+    case CORINFO_INTRINSIC_Pow:
+      IsPure = !MayThrow;
+      break;
     default:
       break;
     }
   }
 
   ABICallSignature ABICallSig(Signature, *this, *JitContext->TheABIInfo);
-  Value *ResultNode =
-      ABICallSig.emitCall(*this, (Value *)TargetNode, MayThrow, Arguments,
-                          (Value *)CallTargetInfo->getIndirectionCellNode(),
-                          IsJmp, (Value **)&Call);
+  Value *ResultNode;
+  if (IsGuarded) {
+    ResultNode = genGuardedCall(CallTargetInfo, ABICallSig, MayThrow, Args,
+                                Arguments, &Call);
+  } else {
+    ResultNode =
+        ABICallSig.emitCall(*this, (Value *)TargetNode, MayThrow, Arguments,
+                            (Value *)CallTargetInfo->getIndirectionCellNode(),
+                            IsJmp, (Value **)&Call);
+  }
 
   // Add VarArgs cookie to outgoing param list
   if (CC == CORINFO_CALLCONV_VARARG) {
@@ -6371,6 +7164,16 @@ IRNode *GenIR::genCall(ReaderCallTargetData *CallTargetInfo, bool MayThrow,
     }
   }
 
+  if (IsPure) {
+    CallSite PureCall((Value *)Call);
+    PureCall.setDoesNotAccessMemory();
+    PureCall.setDoesNotThrow();
+  }
+
+  if (!IsJmp) {
+    noteInlineCandidate(CallTargetInfo, Call);
+  }
+
   *CallNode = Call;
 
   if (ResultType.CorType != CORINFO_TYPE_VOID) {
@@ -6388,6 +7191,74 @@ IRNode *GenIR::genCall(ReaderCallTargetData *CallTargetInfo, bool MayThrow,
   }
 }
 
+Value *GenIR::genGuardedCall(ReaderCallTargetData *CallTargetInfo,
+                             ABICallSignature &ABICallSig, bool MayThrow,
+                             std::vector<IRNode *> &Args,
+                             ArrayRef<Value *> Arguments, IRNode **CallNode) {
+  CORINFO_CLASS_HANDLE GuardClass = CallTargetInfo->getGuardClass();
+  CORINFO_METHOD_HANDLE Method = CallTargetInfo->getMethodHandle();
+  mdToken MethodToken = CallTargetInfo->getMethodToken();
+  const bool IsJmp = false;
+
+  // Compare the object's method table against the guard class. The object
+  // has already been null checked.
+  IRNode *MethodTable = derefAddressNonNull(Args[0], false, true);
+  bool IsIndirect = false;
+  void *ClassHandle = embedClassHandle(GuardClass, &IsIndirect);
+  IRNode *ClassNode =
+      handleToIRNode(mdtClassHandle, ClassHandle, GuardClass, IsIndirect,
+                     IsIndirect, true, false);
+  Value *IsLikelyClass =
+      LLVMBuilder->CreateICmpEQ(MethodTable, ClassNode, "IsLikelyClass");
+
+  TerminatorInst *Goto;
+  BasicBlock *JoinBlock = splitCurrentBlock(&Goto);
+  BasicBlock *DirectBlock = createPointBlock("DevirtualizedCall");
+  BasicBlock *VirtualBlock = createPointBlock("VirtualCall");
+  BranchInst *Branch =
+      BranchInst::Create(DirectBlock, VirtualBlock, IsLikelyClass);
+  replaceInstruction(Goto, Branch);
+
+  // Call the method directly on the fast path.
+  IRBuilder<>::InsertPoint SavedInsertPoint = LLVMBuilder->saveIP();
+  LLVMBuilder->SetInsertPoint(DirectBlock);
+  CORINFO_CALL_INFO *CallInfo = CallTargetInfo->getCallInfo();
+  const bool NeedsNullCheck = false;
+  IRNode *DirectTarget = convertCallTarget(rdrGetDirectCallTarget(
+      Method, MethodToken, CallInfo->codePointerLookup, NeedsNullCheck,
+      canMakeDirectCall(CallTargetInfo)));
+  Value *DirectCall = nullptr;
+  Value *DirectResult =
+      ABICallSig.emitCall(*this, (Value *)DirectTarget, MayThrow, Arguments,
+                          nullptr, IsJmp, &DirectCall);
+  noteInlineCandidate(CallTargetInfo, (IRNode *)DirectCall, Method);
+  // The call may have been emitted as an invoke that ends the block.
+  BasicBlock *DirectExitBlock = LLVMBuilder->GetInsertBlock();
+  LLVMBuilder->CreateBr(JoinBlock);
+
+  // Dispatch as usual on the slow path.
+  LLVMBuilder->SetInsertPoint(VirtualBlock);
+  rdrMakeCallTargetNode(CallTargetInfo, &Args[0]);
+  IRNode *VirtualTarget =
+      convertCallTarget(CallTargetInfo->getCallTargetNode());
+  Value *VirtualResult =
+      ABICallSig.emitCall(*this, (Value *)VirtualTarget, MayThrow, Arguments,
+                          (Value *)CallTargetInfo->getIndirectionCellNode(),
+                          IsJmp, (Value **)CallNode);
+  BasicBlock *VirtualExitBlock = LLVMBuilder->GetInsertBlock();
+  LLVMBuilder->CreateBr(JoinBlock);
+  LLVMBuilder->restoreIP(SavedInsertPoint);
+
+  CorInfoType ResultType =
+      CallTargetInfo->getCallTargetSignature().getResultType().CorType;
+  if (ResultType == CORINFO_TYPE_VOID) {
+    return VirtualResult;
+  }
+  return mergeConditionalResults(JoinBlock, DirectResult, DirectExitBlock,
+                                 VirtualResult, VirtualExitBlock,
+                                 "GuardedCallResult");
+}
+
 IRNode *GenIR::convertToBoxHelperArgumentType(IRNode *Opr, uint32_t DestSize) {
   Type *Ty = Opr->getType();
   switch (Ty->getTypeID()) {
@@ -7126,7 +7997,10 @@ CallSite GenIR::genConditionalHelperCall(
       callHelperImpl(HelperId, MayThrow, ReturnType, Arg1, Arg2);
 
   if (!CallReturns) {
+    // Helpers that do not return raise exceptions; mark them cold so that
+    // block placement moves them out of line.
     HelperCall.setDoesNotReturn();
+    HelperCall.addAttribute(AttributeSet::FunctionIndex, Attribute::Cold);
     LLVMBuilder->CreateUnreachable();
   }
   LLVMBuilder->restoreIP(SavedInsertPoint);
@@ -7155,7 +8029,27 @@ IRNode *GenIR::genNullCheck(IRNode *Node) {
 
   // Insert the conditional throw
   CorInfoHelpFunc HelperId = CORINFO_HELP_THROWNULLREF;
-  genConditionalThrow(Compare, HelperId, "ThrowNullRef");
+  IRNode *Arg1 = nullptr, *Arg2 = nullptr;
+  Type *ReturnType = Type::getVoidTy(*JitContext->LLVMContext);
+  const bool MayThrow = true;
+  const bool CallReturns = false;
+  CallSite ThrowCall =
+      genConditionalHelperCall(Compare, HelperId, MayThrow, ReturnType, Arg1,
+                               Arg2, CallReturns, "ThrowNullRef");
+
+  // Let codegen replace the compare and branch with a load or store that
+  // faults on null, if one immediately follows. The runtime raises the
+  // exception for the fault at the faulting instruction, so this is only
+  // done when the throw would unwind straight to the caller: there is no
+  // way to tell LLVM that the access may transfer control to a handler.
+  if (JitContext->Options->DoImplicitNullCheck && !ThrowCall.isInvoke()) {
+    BasicBlock *CheckBlock =
+        LLVMBuilder->GetInsertBlock()->getSinglePredecessor();
+    assert(CheckBlock != nullptr);
+    LLVMContext &Context = *JitContext->LLVMContext;
+    CheckBlock->getTerminator()->setMetadata(LLVMContext::MD_make_implicit,
+                                             MDNode::get(Context, None));
+  }
 
   return Node;
 }
@@ -7175,6 +8069,16 @@ void GenIR::genBoundsCheck(Value *ArrayLength, Value *Index) {
   Value *UpperBoundCompare =
       LLVMBuilder->CreateICmpUGE(ConvertedIndex, ArrayLength, "BoundsCheck");
   genConditionalThrow(UpperBoundCompare, HelperId, "ThrowIndexOutOfRange");
+
+  // Tag the branch so that range check elimination can find the check even
+  // after the optimizer has rewritten the compare. The throw block doesn't
+  // rejoin, so the branch ends the only predecessor of the current block.
+  BasicBlock *CheckBlock =
+      LLVMBuilder->GetInsertBlock()->getSinglePredecessor();
+  assert(CheckBlock != nullptr);
+  LLVMContext &Context = *JitContext->LLVMContext;
+  CheckBlock->getTerminator()->setMetadata(RANGE_CHECK_METADATA_NAME,
+                                           MDNode::get(Context, None));
 }
 
 /// \brief Get the immediate target (innermost exited finally) for this leave.
@@ -7709,6 +8613,15 @@ BasicBlock *GenIR::insertConditionalPointBlock(Value *Condition,
   BranchInst *Branch = BranchInst::Create(PointBlock, ContinueBlock, Condition);
   replaceInstruction(Goto, Branch);
 
+  if (!Rejoin) {
+    // A point block that does not rejoin ends in a throw. Tell block
+    // placement that it is rarely taken so the throw paths end up after
+    // the hot code rather than interleaved with it.
+    MDBuilder MDB(*JitContext->LLVMContext);
+    Branch->setMetadata(LLVMContext::MD_prof,
+                        MDB.createBranchWeights(1, (1 << 20) - 1));
+  }
+
   if (Rejoin) {
     BasicBlock *RejoinFromBlock = PointBlock;
     // Allow that the point block may have been split to insert invoke
@@ -8312,10 +9225,11 @@ IRNode *GenIR::newArr(CORINFO_RESOLVED_TOKEN *ResolvedToken, IRNode *Arg1) {
   Value *Destination = Constant::getNullValue(ArrayType);
 
   const bool MayThrow = true;
+  IRNode *Array;
   if (JitContext->Flags & CORJIT_FLG_READYTORUN) {
-    return callReadyToRunHelper(CORINFO_HELP_READYTORUN_NEWARR_1, MayThrow,
-                                (IRNode *)Destination, ResolvedToken,
-                                NumOfElements);
+    Array = callReadyToRunHelper(CORINFO_HELP_READYTORUN_NEWARR_1, MayThrow,
+                                 (IRNode *)Destination, ResolvedToken,
+                                 NumOfElements);
   } else {
     // Or token with CORINFO_ANNOT_ARRAY so that we get back an array-type
     // handle.
@@ -8325,9 +9239,46 @@ IRNode *GenIR::newArr(CORINFO_RESOLVED_TOKEN *ResolvedToken, IRNode *Arg1) {
         genericTokenToNode(ResolvedToken, EmbedParent, MustRestoreHandle,
                            (CORINFO_GENERIC_HANDLE *)&ElementType, nullptr);
 
-    return callHelper(getNewArrHelper(ElementType), MayThrow,
-                      (IRNode *)Destination, Token, NumOfElements);
+    Array = callHelper(getNewArrHelper(ElementType), MayThrow,
+                       (IRNode *)Destination, Token, NumOfElements);
   }
+  setAllocationAttributes(CallSite(Array), NumOfElements);
+  return Array;
+}
+
+void GenIR::setAllocationAttributes(CallSite Allocation, Value *NumElements) {
+  Instruction *Call = Allocation.getInstruction();
+  PointerType *ObjectPtrType = cast<PointerType>(Call->getType());
+  LLVMContext &Context = *JitContext->LLVMContext;
+  AttributeSet Attributes = Allocation.getAttributes();
+  Attributes = Attributes.addAttribute(Context, AttributeSet::ReturnIndex,
+                                       Attribute::NonNull);
+  Attributes = Attributes.addAttribute(Context, AttributeSet::ReturnIndex,
+                                       Attribute::NoAlias);
+
+  // The object type describes the method table pointer and the fields, or,
+  // for arrays, the header up to the (zero length) element data.
+  Type *ObjectType = ObjectPtrType->getElementType();
+  if (ObjectType->isSized()) {
+    const DataLayout &DataLayout = JitContext->CurrentModule->getDataLayout();
+    uint64_t Size = DataLayout.getTypeAllocSize(ObjectType);
+    if (NumElements != nullptr) {
+      // Count the elements when the length is a known, small constant.
+      StructType *ArrayStructType = cast<StructType>(ObjectType);
+      unsigned DataField = ArrayStructType->getNumElements() - 1;
+      Type *DataType = ArrayStructType->getElementType(DataField);
+      Type *ElementType = cast<ArrayType>(DataType)->getElementType();
+      ConstantInt *Length = dyn_cast<ConstantInt>(NumElements);
+      const uint64_t MaxLength = 1 << 16;
+      if ((Length != nullptr) && (Length->getZExtValue() <= MaxLength)) {
+        Size += Length->getZExtValue() *
+                DataLayout.getTypeAllocSize(ElementType);
+      }
+    }
+    Attributes = Attributes.addDereferenceableAttr(
+        Context, AttributeSet::ReturnIndex, Size);
+  }
+  Allocation.setAttributes(Attributes);
 }
 
 // CastOp - Generates code for castclass or isinst.
@@ -8354,27 +9305,21 @@ IRNode *GenIR::castOp(CORINFO_RESOLVED_TOKEN *ResolvedToken, IRNode *ObjRefNode,
   bool EmbedParent = false;
   bool MustRestoreHandle = false;
 
-  IRNode *ClassHandleNode = genericTokenToNode(
-      ResolvedToken, EmbedParent, MustRestoreHandle, &HandleType, nullptr);
+  bool IsRuntimeLookup = false;
+  IRNode *ClassHandleNode =
+      genericTokenToNode(ResolvedToken, EmbedParent, MustRestoreHandle,
+                         &HandleType, &IsRuntimeLookup);
   bool Optimize = false;
-  if (!disableCastClassOptimization()) {
+  if (!disableCastClassOptimization() && !IsRuntimeLookup) {
     switch (HelperId) {
     case CORINFO_HELP_CHKCASTCLASS:
-      // TODO: It's not clear why calling this helper is safe. It assumes
-      // that trivial checks are inlined. Check this again if we decide to
-      // enable cast class optimization.
-      HelperId = CORINFO_HELP_CHKCASTCLASS_SPECIAL;
-
-    //
-    // FALL-THROUGH
-    //
-
     case CORINFO_HELP_ISINSTANCEOFCLASS: {
-      uint32_t Flags = getClassAttribs((CORINFO_CLASS_HANDLE)HandleType);
+      CORINFO_CLASS_HANDLE CastClass = (CORINFO_CLASS_HANDLE)HandleType;
+      uint32_t Flags = getClassAttribs(CastClass);
       if ((Flags & CORINFO_FLG_FINAL) &&
           !(Flags & (CORINFO_FLG_MARSHAL_BYREF | CORINFO_FLG_CONTEXTFUL |
                      CORINFO_FLG_SHAREDINST))) {
-        Optimize = true;
+        Optimize = canInlineTypeCheckWithObjectVTable(CastClass);
       }
     } break;
 
@@ -8383,9 +9328,13 @@ IRNode *GenIR::castOp(CORINFO_RESOLVED_TOKEN *ResolvedToken, IRNode *ObjRefNode,
     }
   }
 
-  // Generate the helper call or intrinsic
+  if (Optimize) {
+    return genInlineCast(ClassHandleNode, ObjRefNode, HelperId, ResultType);
+  }
+
+  // Generate the helper call
   const bool IsVolatile = false;
-  const bool DoesNotInvokeStaticCtor = Optimize;
+  const bool DoesNotInvokeStaticCtor = false;
   return (IRNode *)callHelperImpl(HelperId, MayThrow, ResultType,
                                   ClassHandleNode, ObjRefNode, nullptr, nullptr,
                                   Reader_AlignUnknown, IsVolatile,
@@ -8393,13 +9342,71 @@ IRNode *GenIR::castOp(CORINFO_RESOLVED_TOKEN *ResolvedToken, IRNode *ObjRefNode,
       .getInstruction();
 }
 
+IRNode *GenIR::genInlineCast(IRNode *ClassHandleNode, IRNode *ObjRefNode,
+                             CorInfoHelpFunc HelperId, Type *ResultType) {
+  const bool IsIsInst = (HelperId == CORINFO_HELP_ISINSTANCEOFCLASS);
+  Value *Object = LLVMBuilder->CreatePointerCast(ObjRefNode, ResultType);
+
+  // Null passes either kind of cast unchanged.
+  Value *IsNull = LLVMBuilder->CreateIsNull(ObjRefNode, "CastIsNull");
+  TerminatorInst *Goto;
+  BasicBlock *JoinBlock = splitCurrentBlock(&Goto);
+  BasicBlock *NullBlock = Goto->getParent();
+  BasicBlock *CheckBlock = createPointBlock("CastCheck");
+  replaceInstruction(Goto, BranchInst::Create(JoinBlock, CheckBlock, IsNull));
+
+  // The class is sealed, so the object is an instance of it exactly when its
+  // method table is the class handle.
+  IRBuilder<>::InsertPoint SavedInsertPoint = LLVMBuilder->saveIP();
+  LLVMBuilder->SetInsertPoint(CheckBlock);
+  IRNode *MethodTable = derefAddressNonNull(ObjRefNode, false, true);
+  Value *IsClass =
+      LLVMBuilder->CreateICmpEQ(MethodTable, ClassHandleNode, "CastIsClass");
+
+  PHINode *Result = createPHINode(JoinBlock, ResultType, 3, "CastResult");
+  Result->addIncoming(Object, NullBlock);
+  if (IsIsInst) {
+    // No other class can match, so there is no need for the helper.
+    Value *Null = Constant::getNullValue(ResultType);
+    Result->addIncoming(LLVMBuilder->CreateSelect(IsClass, Object, Null),
+                        CheckBlock);
+    LLVMBuilder->CreateBr(JoinBlock);
+    LLVMBuilder->restoreIP(SavedInsertPoint);
+    return (IRNode *)Result;
+  }
+
+  // A failed castclass throws, so the helper is called on the cold path. The
+  // trivial checks have been made, so the special helper can be used.
+  BasicBlock *HelperBlock = createPointBlock("CastFail");
+  BranchInst *Branch =
+      LLVMBuilder->CreateCondBr(IsClass, JoinBlock, HelperBlock);
+  MDBuilder MDB(*JitContext->LLVMContext);
+  Branch->setMetadata(LLVMContext::MD_prof,
+                      MDB.createBranchWeights((1 << 20) - 1, 1));
+  Result->addIncoming(Object, CheckBlock);
+
+  LLVMBuilder->SetInsertPoint(HelperBlock);
+  const bool MayThrow = true;
+  const bool IsVolatile = false;
+  const bool DoesNotInvokeStaticCtor = true;
+  CallSite HelperCall = callHelperImpl(
+      CORINFO_HELP_CHKCASTCLASS_SPECIAL, MayThrow, ResultType, ClassHandleNode,
+      ObjRefNode, nullptr, nullptr, Reader_AlignUnknown, IsVolatile,
+      DoesNotInvokeStaticCtor);
+  HelperCall.addAttribute(AttributeSet::FunctionIndex, Attribute::Cold);
+  // The call may have been emitted as an invoke that ends the block.
+  Result->addIncoming(HelperCall.getInstruction(),
+                      LLVMBuilder->GetInsertBlock());
+  LLVMBuilder->CreateBr(JoinBlock);
+  LLVMBuilder->restoreIP(SavedInsertPoint);
+
+  return (IRNode *)Result;
+}
+
 // Override the cast class optimization
 bool GenIR::disableCastClassOptimization() {
-  // TODO: We may want to enable cast class optimization unless it's disabled
-  // by some flags or we are generating debug code or it's causing problems
-  // downstream.
-
-  return true;
+  // Keep casts as plain helper calls in debug code.
+  return !JitContext->Options->EnableOptimization;
 }
 
 /// Optionally generate inline code for the \p abs opcode
@@ -8441,6 +9448,52 @@ bool GenIR::sqrt(IRNode *Argument, IRNode **Result) {
   return false;
 }
 
+bool GenIR::mathIntrinsic(CorInfoIntrinsics IntrinsicID, IRNode *Argument,
+                          IRNode **Result) {
+  if (!Argument->getType()->isDoubleTy()) {
+    return false;
+  }
+
+  // These methods compute the same function as the C library, so they can
+  // be LLVM intrinsics that the optimizer folds, hoists and vectorizes like
+  // any other arithmetic. Round rounds halfway cases to even, which is what
+  // rint does in the default rounding mode.
+  Intrinsic::ID ID;
+  unsigned Opcode;
+  switch (IntrinsicID) {
+  case CORINFO_INTRINSIC_Round:
+    ID = Intrinsic::rint;
+    Opcode = ISD::FRINT;
+    break;
+  case CORINFO_INTRINSIC_Ceiling:
+    ID = Intrinsic::ceil;
+    Opcode = ISD::FCEIL;
+    break;
+  case CORINFO_INTRINSIC_Floor:
+    ID = Intrinsic::floor;
+    Opcode = ISD::FFLOOR;
+    break;
+  default:
+    return false;
+  }
+
+  // Codegen turns the intrinsic into a call to the C library function when
+  // the target has no instruction for it, and the jit has no C library code
+  // to bind that call to. Keep the call to the managed method instead.
+  const TargetLowering *Lowering =
+      JitContext->TM->getSubtargetImpl(*Function)->getTargetLowering();
+  if (!Lowering->isOperationLegal(Opcode, MVT::f64)) {
+    return false;
+  }
+
+  Type *Types[] = {Argument->getType()};
+  Value *Fn = Intrinsic::getDeclaration(JitContext->CurrentModule, ID, Types);
+  bool MayThrow = false;
+  Value *Call = makeCall(Fn, MayThrow, Argument).getInstruction();
+  *Result = (IRNode *)Call;
+  return true;
+}
+
 IRNode *GenIR::localAlloc(IRNode *Arg, bool ZeroInit) {
   // We should have noticed this during the first pass.
   assert(HasLocAlloc && "need to detect localloc early");
@@ -9119,6 +10172,162 @@ IRNode *GenIR::vectorMin(IRNode *Vector1, IRNode *Vector2, bool IsSigned) {
   return (IRNode *)LLVMBuilder->CreateSelect(CompareRes, Vector2, Vector1);
 }
 
+IRNode *GenIR::vectorAndNot(IRNode *Vector1, IRNode *Vector2) {
+  assert(Vector2->getType() == Vector1->getType());
+  Type *ResultType = Vector1->getType();
+  Type *IntType = VectorType::getInteger(cast<VectorType>(ResultType));
+  Value *Int1 = LLVMBuilder->CreateBitCast(Vector1, IntType);
+  Value *Int2 = LLVMBuilder->CreateBitCast(Vector2, IntType);
+  Value *Result = LLVMBuilder->CreateAnd(Int1, LLVMBuilder->CreateNot(Int2));
+  return (IRNode *)LLVMBuilder->CreateBitCast(Result, ResultType);
+}
+
+IRNode *GenIR::vectorNarrow(IRNode *Vector1, IRNode *Vector2) {
+  if (Vector2->getType() != Vector1->getType()) {
+    return 0;
+  }
+  VectorType *SourceType = cast<VectorType>(Vector1->getType());
+  Type *ElementType = SourceType->getElementType();
+  unsigned NumElements = SourceType->getNumElements();
+  LLVMContext &Context = *JitContext->LLVMContext;
+  Type *NarrowElementType = nullptr;
+  if (ElementType->isDoubleTy()) {
+    NarrowElementType = Type::getFloatTy(Context);
+  } else if (ElementType->isIntegerTy() &&
+             (ElementType->getIntegerBitWidth() > 8)) {
+    NarrowElementType =
+        IntegerType::get(Context, ElementType->getIntegerBitWidth() / 2);
+  } else {
+    return 0;
+  }
+
+  // Narrow each half, then concatenate them.
+  Type *NarrowType = VectorType::get(NarrowElementType, NumElements);
+  Value *Low;
+  Value *High;
+  if (ElementType->isFloatingPointTy()) {
+    Low = LLVMBuilder->CreateFPTrunc(Vector1, NarrowType);
+    High = LLVMBuilder->CreateFPTrunc(Vector2, NarrowType);
+  } else {
+    Low = LLVMBuilder->CreateTrunc(Vector1, NarrowType);
+    High = LLVMBuilder->CreateTrunc(Vector2, NarrowType);
+  }
+  SmallVector<uint32_t, 64> Mask;
+  for (uint32_t Counter = 0; Counter < 2 * NumElements; ++Counter) {
+    Mask.push_back(Counter);
+  }
+  return (IRNode *)LLVMBuilder->CreateShuffleVector(
+      Low, High, ConstantDataVector::get(Context, Mask));
+}
+
+IRNode *GenIR::vectorAllEqual(IRNode *Vector1, IRNode *Vector2,
+                              bool IsNotEqual) {
+  IRNode *Compare = vectorEqual(Vector1, Vector2);
+  if (!Compare) {
+    return 0;
+  }
+
+  // Gather the lane results into one bit each and check they are all set.
+  LLVMContext &Context = *JitContext->LLVMContext;
+  unsigned NumElements = Compare->getType()->getVectorNumElements();
+  Type *BitsType = IntegerType::get(Context, NumElements);
+  Value *Bits = LLVMBuilder->CreateBitCast(Compare, BitsType);
+  Value *Result = LLVMBuilder->CreateICmpEQ(
+      Bits, Constant::getAllOnesValue(Bits->getType()));
+  if (IsNotEqual) {
+    Result = LLVMBuilder->CreateNot(Result);
+  }
+  return convertToStackType((IRNode *)Result, CorInfoType::CORINFO_TYPE_BOOL);
+}
+
+IRNode *GenIR::vectorCompare(ReaderSIMDIntrinsic OperationCode,
+                             IRNode *Vector1, IRNode *Vector2, bool IsSigned,
+                             CORINFO_CLASS_HANDLE ResultClass) {
+  assert(Vector2->getType() == Vector1->getType());
+  VectorType *SourceType = cast<VectorType>(Vector1->getType());
+  Type *ResultType = getType(CorInfoType::CORINFO_TYPE_VALUECLASS, ResultClass);
+  if (!ResultType->isVectorTy() || (ResultType->getPrimitiveSizeInBits() !=
+                                    SourceType->getPrimitiveSizeInBits())) {
+    return 0;
+  }
+
+  bool IsFloat = SourceType->getElementType()->isFloatingPointTy();
+  CmpInst::Predicate Predicate;
+  switch (OperationCode) {
+  case GT:
+    Predicate = IsFloat ? CmpInst::FCMP_OGT
+                        : (IsSigned ? CmpInst::ICMP_SGT : CmpInst::ICMP_UGT);
+    break;
+  case GE:
+    Predicate = IsFloat ? CmpInst::FCMP_OGE
+                        : (IsSigned ? CmpInst::ICMP_SGE : CmpInst::ICMP_UGE);
+    break;
+  case LT:
+    Predicate = IsFloat ? CmpInst::FCMP_OLT
+                        : (IsSigned ? CmpInst::ICMP_SLT : CmpInst::ICMP_ULT);
+    break;
+  case LE:
+    Predicate = IsFloat ? CmpInst::FCMP_OLE
+                        : (IsSigned ? CmpInst::ICMP_SLE : CmpInst::ICMP_ULE);
+    break;
+  case EQMASK:
+    Predicate = IsFloat ? CmpInst::FCMP_OEQ : CmpInst::ICMP_EQ;
+    break;
+  default:
+    return 0;
+  }
+
+  // The result has all bits set in the lanes where the compare holds.
+  Value *Compare = IsFloat
+                       ? LLVMBuilder->CreateFCmp(Predicate, Vector1, Vector2)
+                       : LLVMBuilder->CreateICmp(Predicate, Vector1, Vector2);
+  Value *Mask =
+      LLVMBuilder->CreateSExt(Compare, VectorType::getInteger(SourceType));
+  return (IRNode *)LLVMBuilder->CreateBitCast(Mask, ResultType);
+}
+
+IRNode *GenIR::vectorDot(IRNode *Vector1, IRNode *Vector2,
+                         CorInfoType ResType) {
+  IRNode *Product = vectorMul(Vector1, Vector2);
+  if (!Product) {
+    return 0;
+  }
+
+  unsigned NumElements = Product->getType()->getVectorNumElements();
+  Type *ElementType = Product->getType()->getVectorElementType();
+  bool IsFloat = ElementType->isFloatingPointTy();
+  Value *Sum = Product;
+  if (isPowerOf2_32(NumElements)) {
+    // Add the upper half of the products to the lower half until one
+    // element is left.
+    LLVMContext &Context = *JitContext->LLVMContext;
+    for (uint32_t Width = NumElements / 2; Width >= 1; Width /= 2) {
+      SmallVector<uint32_t, 32> LowMask;
+      SmallVector<uint32_t, 32> HighMask;
+      for (uint32_t Counter = 0; Counter < Width; ++Counter) {
+        LowMask.push_back(Counter);
+        HighMask.push_back(Width + Counter);
+      }
+      Value *Undef = UndefValue::get(Sum->getType());
+      Value *Low = LLVMBuilder->CreateShuffleVector(
+          Sum, Undef, ConstantDataVector::get(Context, LowMask));
+      Value *High = LLVMBuilder->CreateShuffleVector(
+          Sum, Undef, ConstantDataVector::get(Context, HighMask));
+      Sum = IsFloat ? LLVMBuilder->CreateFAdd(Low, High)
+                    : LLVMBuilder->CreateAdd(Low, High);
+    }
+    Sum = LLVMBuilder->CreateExtractElement(Sum, uint64_t(0));
+  } else {
+    Sum = LLVMBuilder->CreateExtractElement(Product, uint64_t(0));
+    for (uint64_t Counter = 1; Counter < NumElements; ++Counter) {
+      Value *Element = LLVMBuilder->CreateExtractElement(Product, Counter);
+      Sum = IsFloat ? LLVMBuilder->CreateFAdd(Sum, Element)
+                    : LLVMBuilder->CreateAdd(Sum, Element);
+    }
+  }
+  return convertToStackType((IRNode *)Sum, ResType);
+}
+
 Type *GenIR::getVectorIntType(unsigned VectorByteSize) {
   LLVMContext &Context = LLVMBuilder->getContext();
   Type *IntType = llvm::Type::getInt32Ty(Context);
@@ -9198,6 +10407,118 @@ IRNode *GenIR::vectorSqrt(IRNode *Vector) {
   return 0;
 }
 
+IRNode *GenIR::vectorNeg(IRNode *Vector) {
+  if (Vector->getType()->getVectorElementType()->isFloatingPointTy()) {
+    return (IRNode *)LLVMBuilder->CreateFNeg(Vector);
+  }
+  return (IRNode *)LLVMBuilder->CreateNeg(Vector);
+}
+
+IRNode *GenIR::vectorNot(IRNode *Vector) {
+  Type *ResultType = Vector->getType();
+  Type *IntType = VectorType::getInteger(cast<VectorType>(ResultType));
+  Value *Result =
+      LLVMBuilder->CreateNot(LLVMBuilder->CreateBitCast(Vector, IntType));
+  return (IRNode *)LLVMBuilder->CreateBitCast(Result, ResultType);
+}
+
+IRNode *GenIR::vectorConvert(IRNode *Vector, bool IsSigned,
+                             CORINFO_CLASS_HANDLE ResultClass) {
+  Type *SourceType = Vector->getType();
+  Type *ResultType = getType(CorInfoType::CORINFO_TYPE_VALUECLASS, ResultClass);
+  if (!ResultType->isVectorTy() || (ResultType->getVectorNumElements() !=
+                                    SourceType->getVectorNumElements())) {
+    return 0;
+  }
+
+  bool IsSourceFloat = SourceType->getVectorElementType()->isFloatingPointTy();
+  bool IsResultFloat = ResultType->getVectorElementType()->isFloatingPointTy();
+  if (IsSourceFloat && IsResultFloat) {
+    return (IRNode *)LLVMBuilder->CreateFPCast(Vector, ResultType);
+  }
+  if (IsResultFloat) {
+    return IsSigned ? (IRNode *)LLVMBuilder->CreateSIToFP(Vector, ResultType)
+                    : (IRNode *)LLVMBuilder->CreateUIToFP(Vector, ResultType);
+  }
+  if (IsSourceFloat) {
+    return getIsSigned(ResultClass)
+               ? (IRNode *)LLVMBuilder->CreateFPToSI(Vector, ResultType)
+               : (IRNode *)LLVMBuilder->CreateFPToUI(Vector, ResultType);
+  }
+  return 0;
+}
+
+IRNode *GenIR::vectorConditionalSelect(IRNode *Mask, IRNode *Vector1,
+                                       IRNode *Vector2) {
+  Type *ResultType = Vector1->getType();
+  if ((Vector2->getType() != ResultType) ||
+      (Mask->getType()->getPrimitiveSizeInBits() !=
+       ResultType->getPrimitiveSizeInBits())) {
+    return 0;
+  }
+  Type *IntType = VectorType::getInteger(cast<VectorType>(ResultType));
+  Value *IntMask = LLVMBuilder->CreateBitCast(Mask, IntType);
+  Value *Int1 = LLVMBuilder->CreateBitCast(Vector1, IntType);
+  Value *Int2 = LLVMBuilder->CreateBitCast(Vector2, IntType);
+  Value *Selected1 = LLVMBuilder->CreateAnd(IntMask, Int1);
+  Value *NotMask = LLVMBuilder->CreateNot(IntMask);
+  Value *Selected2 = LLVMBuilder->CreateAnd(NotMask, Int2);
+  Value *Result = LLVMBuilder->CreateOr(Selected1, Selected2);
+  return (IRNode *)LLVMBuilder->CreateBitCast(Result, ResultType);
+}
+
+IRNode *GenIR::vectorWiden(IRNode *Vector, IRNode *LowPointer,
+                           IRNode *HighPointer, bool IsSigned) {
+  VectorType *SourceType = cast<VectorType>(Vector->getType());
+  Type *ElementType = SourceType->getElementType();
+  unsigned NumElements = SourceType->getNumElements();
+  LLVMContext &Context = *JitContext->LLVMContext;
+  if (!LowPointer->getType()->isPointerTy() ||
+      !HighPointer->getType()->isPointerTy() || ((NumElements % 2) != 0)) {
+    return 0;
+  }
+  Type *WideElementType = nullptr;
+  if (ElementType->isFloatTy()) {
+    WideElementType = Type::getDoubleTy(Context);
+  } else if (ElementType->isIntegerTy() &&
+             (ElementType->getIntegerBitWidth() < 64)) {
+    WideElementType =
+        IntegerType::get(Context, ElementType->getIntegerBitWidth() * 2);
+  } else {
+    return 0;
+  }
+
+  // Split the vector into halves and extend each of them.
+  Type *WideType = VectorType::get(WideElementType, NumElements / 2);
+  SmallVector<uint32_t, 32> LowMask;
+  SmallVector<uint32_t, 32> HighMask;
+  for (uint32_t Counter = 0; Counter < NumElements / 2; ++Counter) {
+    LowMask.push_back(Counter);
+    HighMask.push_back(NumElements / 2 + Counter);
+  }
+  Value *Undef = UndefValue::get(SourceType);
+  Value *Low = LLVMBuilder->CreateShuffleVector(
+      Vector, Undef, ConstantDataVector::get(Context, LowMask));
+  Value *High = LLVMBuilder->CreateShuffleVector(
+      Vector, Undef, ConstantDataVector::get(Context, HighMask));
+  if (ElementType->isFloatingPointTy()) {
+    Low = LLVMBuilder->CreateFPExt(Low, WideType);
+    High = LLVMBuilder->CreateFPExt(High, WideType);
+  } else {
+    Low = LLVMBuilder->CreateIntCast(Low, WideType, IsSigned);
+    High = LLVMBuilder->CreateIntCast(High, WideType, IsSigned);
+  }
+
+  unsigned LowAddressSpace = LowPointer->getType()->getPointerAddressSpace();
+  unsigned HighAddressSpace = HighPointer->getType()->getPointerAddressSpace();
+  Value *LowAddress = LLVMBuilder->CreatePointerCast(
+      LowPointer, PointerType::get(WideType, LowAddressSpace));
+  Value *HighAddress = LLVMBuilder->CreatePointerCast(
+      HighPointer, PointerType::get(WideType, HighAddressSpace));
+  LLVMBuilder->CreateStore(Low, LowAddress);
+  return (IRNode *)LLVMBuilder->CreateStore(High, HighAddress);
+}
+
 IRNode *GenIR::generateIsHardwareAccelerated(CORINFO_CLASS_HANDLE Class) {
   return (IRNode *)ConstantInt::get(Type::getInt32Ty(LLVMBuilder->getContext()),
                                     1);
@@ -9261,19 +10582,53 @@ IRNode *GenIR::vectorCtorFromFloats(int VectorSize, IRNode *Vector,
   return 0;
 }
 
+IRNode *GenIR::vectorArrayAddress(IRNode *Array, IRNode *Index,
+                                  VectorType *VectorTy) {
+  Type *ElementType = VectorTy->getElementType();
+  Array = ensureIsArray(Array, ElementType);
+
+  // Loading the length checks the array for null.
+  Value *ArrayLength = loadLen(Array);
+
+  // Like the managed constructor, throw IndexOutOfRangeException whether the
+  // index is bad or the array is too short. The unsigned compare catches
+  // negative indices too; the room left after a bad index is meaningless,
+  // but then the first compare already holds.
+  Type *ArrayLengthType = ArrayLength->getType();
+  bool IsSigned = false;
+  Value *ConvertedIndex =
+      LLVMBuilder->CreateIntCast(Index, ArrayLengthType, IsSigned);
+  Value *IndexCompare =
+      LLVMBuilder->CreateICmpUGE(ConvertedIndex, ArrayLength, "IndexCheck");
+  Value *Room = LLVMBuilder->CreateSub(ArrayLength, ConvertedIndex);
+  Value *NumElements =
+      ConstantInt::get(ArrayLengthType, VectorTy->getNumElements());
+  Value *SizeCompare =
+      LLVMBuilder->CreateICmpULT(Room, NumElements, "SizeCheck");
+  genConditionalThrow(LLVMBuilder->CreateOr(IndexCompare, SizeCompare),
+                      CORINFO_HELP_RNGCHKFAIL, "ThrowIndexOutOfRange");
+
+  PointerType *Ty = cast<PointerType>(Array->getType());
+  StructType *ReferentTy = cast<StructType>(Ty->getPointerElementType());
+  unsigned int RawArrayStructFieldIndex = ReferentTy->getNumElements() - 1;
+  LLVMContext &Context = *JitContext->LLVMContext;
+  Value *Indices[] = {
+      ConstantInt::get(Type::getInt32Ty(Context), 0),
+      ConstantInt::get(Type::getInt32Ty(Context), RawArrayStructFieldIndex),
+      Index};
+  Value *Address = LLVMBuilder->CreateInBoundsGEP(Array, Indices);
+  unsigned AddressSpace = Address->getType()->getPointerAddressSpace();
+  return (IRNode *)LLVMBuilder->CreatePointerCast(
+      Address, PointerType::get(VectorTy, AddressSpace));
+}
+
 IRNode *GenIR::vectorCtorFromArray(int VectorSize, IRNode *Vector,
                                    IRNode *Array, IRNode *Index) {
-  llvm::LLVMContext &Context = *JitContext->LLVMContext;
-  Type *IntTy = Type::getInt32Ty(Context);
-  for (int Counter = 0; Counter < VectorSize; ++Counter) {
-    IRNode *ExtractedArg =
-        (IRNode *)LLVMBuilder->CreateLoad(genArrayElemAddress(
-            Array, Index, Vector->getType()->getVectorElementType()));
-    Vector = (IRNode *)LLVMBuilder->CreateInsertElement(Vector, ExtractedArg,
-                                                        Counter);
-    Index = (IRNode *)LLVMBuilder->CreateAdd(Index, ConstantInt::get(IntTy, 1));
-  }
-  return Vector;
+  VectorType *VectorTy = cast<VectorType>(Vector->getType());
+  assert((int)VectorTy->getNumElements() == VectorSize);
+  IRNode *Address = vectorArrayAddress(Array, Index, VectorTy);
+  unsigned Alignment = VectorTy->getElementType()->getPrimitiveSizeInBits() / 8;
+  return (IRNode *)LLVMBuilder->CreateAlignedLoad(Address, Alignment);
 }
 
 IRNode *GenIR::vectorCtorFromPointer(int VectorSize, IRNode *Vector,
@@ -9386,8 +10741,13 @@ IRNode *GenIR::vectorCtor(CORINFO_CLASS_HANDLE Class, IRNode *This,
 #pragma endregion
   } else {
     if (Args.size() == 1) {
-      if (!Args[0]->getType()->isPointerTy()) {
+      Type *ArgType = Args[0]->getType();
+      if (!ArgType->isPointerTy()) {
         Return = vectorCtorFromOne(VectorSize, Vector, Args);
+      } else if (ArgType->getPointerElementType()->isAggregateType()) {
+        IRNode *Index = (IRNode *)ConstantInt::get(
+            Type::getInt32Ty(*JitContext->LLVMContext), 0);
+        Return = vectorCtorFromArray(VectorSize, Vector, Args[0], Index);
       } else {
         return 0;
       }
@@ -9429,20 +10789,20 @@ llvm::Type *GenIR::getBaseTypeAndSizeOfSIMDType(CORINFO_CLASS_HANDLE Class,
                                                 int &VectorLength,
                                                 bool &IsGeneric,
                                                 bool &IsSigned) {
-  // TODO t-seand : issue #720, check thread safety.
-  static CORINFO_CLASS_HANDLE SIMDFloatHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDDoubleHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDIntHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDUShortHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDUByteHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDShortHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDByteHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDLongHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDUIntHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDULongHandle = 0;
-  static CORINFO_CLASS_HANDLE SIMDVector2Handle = 0;
-  static CORINFO_CLASS_HANDLE SIMDVector3Handle = 0;
-  static CORINFO_CLASS_HANDLE SIMDVector4Handle = 0;
+  // The handles are cached across jit requests, which may run concurrently.
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDFloatHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDDoubleHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDIntHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDUShortHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDUByteHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDShortHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDByteHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDLongHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDUIntHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDULongHandle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDVector2Handle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDVector3Handle(nullptr);
+  static std::atomic<CORINFO_CLASS_HANDLE> SIMDVector4Handle(nullptr);
 
   LLVMContext &Context = *JitContext->LLVMContext;
 
@@ -9583,4 +10943,12 @@ IRNode *GenIR::vectorGetItem(IRNode *VectorPointer, IRNode *Index,
   return convertToStackType(Result, ResType);
 }
 
+IRNode *GenIR::vectorCopyTo(IRNode *VectorPointer, IRNode *Array,
+                            IRNode *Index) {
+  // The managed CopyTo throws ArgumentOutOfRangeException for a bad index
+  // and ArgumentException if the vector doesn't fit, and the EE this jit
+  // is built against has no helpers that throw those. Keep the call.
+  return 0;
+}
+
 #pragma endregion
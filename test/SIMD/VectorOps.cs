@@ -0,0 +1,400 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license.
+// See LICENSE file in the project root for full license information.
+//
+// Micro-benchmarks for the System.Numerics vector operations that LLILC
+// expands inline. Each benchmark method exercises one group of operations
+// over arrays, stepping by Vector<T>.Count, and its results are checked
+// against a scalar loop. llilc_simdbench.py dumps the LLVM IR of these
+// methods to check each of them is vectorized, and compares their times
+// with and without COMPlus_DisableSIMDIntrinsic.
+//
+// usage: VectorOps [iterations]
+//
+// Returns 100 if every result is correct.
+
+using System;
+using System.Diagnostics;
+using System.Numerics;
+
+public static class VectorOps
+{
+    const int Length = 1 << 14;
+
+    static float[] FloatA = new float[Length];
+    static float[] FloatB = new float[Length];
+    static float[] FloatOut = new float[Length];
+    static int[] IntA = new int[Length];
+    static int[] IntB = new int[Length];
+    static int[] IntOut = new int[Length];
+    static short[] ShortA = new short[Length];
+    static short[] ShortOut = new short[Length];
+
+    static bool Failed = false;
+
+    // Vector.Add, Subtract, Multiply and Divide, along with the
+    // constructor from an array.
+    public static void NamedArithmetic(float[] a, float[] b, float[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<float>.Count)
+        {
+            Vector<float> x = new Vector<float>(a, i);
+            Vector<float> y = new Vector<float>(b, i);
+            Vector<float> sum = Vector.Add(x, y);
+            Vector<float> difference = Vector.Subtract(x, y);
+            Vector<float> product = Vector.Multiply(sum, difference);
+            Vector.Divide(product, y).CopyTo(result, i);
+        }
+    }
+
+    // Vector.BitwiseAnd, BitwiseOr and Xor.
+    public static void NamedBitwise(int[] a, int[] b, int[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<int>.Count)
+        {
+            Vector<int> x = new Vector<int>(a, i);
+            Vector<int> y = new Vector<int>(b, i);
+            Vector<int> both = Vector.BitwiseAnd(x, y);
+            Vector<int> either = Vector.BitwiseOr(x, y);
+            Vector.Xor(both, either).CopyTo(result, i);
+        }
+    }
+
+    public static void AndNot(int[] a, int[] b, int[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<int>.Count)
+        {
+            Vector<int> x = new Vector<int>(a, i);
+            Vector<int> y = new Vector<int>(b, i);
+            Vector.AndNot(x, y).CopyTo(result, i);
+        }
+    }
+
+    public static void OnesComplement(int[] a, int[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<int>.Count)
+        {
+            Vector<int> x = new Vector<int>(a, i);
+            Vector.OnesComplement(x).CopyTo(result, i);
+        }
+    }
+
+    public static void Negate(float[] a, float[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<float>.Count)
+        {
+            Vector<float> x = new Vector<float>(a, i);
+            Vector.Negate(x).CopyTo(result, i);
+        }
+    }
+
+    // Vector.GreaterThan and GreaterThanOrEqual on floats, LessThan and
+    // LessThanOrEqual on ints. Each mask lane is -1 where the compare holds,
+    // so subtracting the masks counts the lanes.
+    public static void Compare(float[] a, float[] b, int[] c, int[] d,
+                               int[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<float>.Count)
+        {
+            Vector<float> x = new Vector<float>(a, i);
+            Vector<float> y = new Vector<float>(b, i);
+            Vector<int> z = new Vector<int>(c, i);
+            Vector<int> w = new Vector<int>(d, i);
+            Vector<int> count = Vector<int>.Zero;
+            count -= Vector.GreaterThan(x, y);
+            count -= Vector.GreaterThanOrEqual(x, y);
+            count -= Vector.LessThan(z, w);
+            count -= Vector.LessThanOrEqual(z, w);
+            count.CopyTo(result, i);
+        }
+    }
+
+    // The static Vector.Equals, which returns a mask.
+    public static void EqualsMask(int[] a, int[] b, int[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<int>.Count)
+        {
+            Vector<int> x = new Vector<int>(a, i);
+            Vector<int> y = new Vector<int>(b, i);
+            Vector.Equals(x, y).CopyTo(result, i);
+        }
+    }
+
+    // The larger of each pair, picked by a mask.
+    public static void ConditionalSelect(float[] a, float[] b, float[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<float>.Count)
+        {
+            Vector<float> x = new Vector<float>(a, i);
+            Vector<float> y = new Vector<float>(b, i);
+            Vector.ConditionalSelect(Vector.GreaterThan(x, y), x, y)
+                .CopyTo(result, i);
+        }
+    }
+
+    public static float Dot(float[] a, float[] b)
+    {
+        float sum = 0;
+        for (int i = 0; i < a.Length; i += Vector<float>.Count)
+        {
+            Vector<float> x = new Vector<float>(a, i);
+            Vector<float> y = new Vector<float>(b, i);
+            sum += Vector.Dot(x, y);
+        }
+        return sum;
+    }
+
+    // Each short is widened to an int, and the two halves are added back
+    // together lane by lane.
+    public static void Widen(short[] a, int[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<short>.Count)
+        {
+            Vector<short> x = new Vector<short>(a, i);
+            Vector<int> low;
+            Vector<int> high;
+            Vector.Widen(x, out low, out high);
+            (low + high).CopyTo(result, i / 2);
+        }
+    }
+
+    public static void Narrow(int[] a, short[] result)
+    {
+        for (int i = 0; i < a.Length; i += 2 * Vector<int>.Count)
+        {
+            Vector<int> low = new Vector<int>(a, i);
+            Vector<int> high = new Vector<int>(a, i + Vector<int>.Count);
+            Vector.Narrow(low, high).CopyTo(result, i);
+        }
+    }
+
+    // Vector.ConvertToSingle and ConvertToInt32.
+    public static void Convert(int[] a, float[] b, float[] result)
+    {
+        for (int i = 0; i < a.Length; i += Vector<int>.Count)
+        {
+            Vector<float> x = Vector.ConvertToSingle(new Vector<int>(a, i));
+            Vector<int> y = Vector.ConvertToInt32(new Vector<float>(b, i));
+            (x + Vector.ConvertToSingle(y)).CopyTo(result, i);
+        }
+    }
+
+    // op_Equality and op_Inequality, which reduce to a single bool.
+    public static int VectorEquality(float[] a, float[] b)
+    {
+        int count = 0;
+        Vector<float> first = new Vector<float>(a[0]);
+        for (int i = 0; i < a.Length; i += Vector<float>.Count)
+        {
+            Vector<float> x = new Vector<float>(a, i);
+            Vector<float> y = new Vector<float>(b, i);
+            if (x == y)
+            {
+                count += 2;
+            }
+            if (x != first)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    static void Initialize()
+    {
+        for (int i = 0; i < Length; i++)
+        {
+            FloatA[i] = (i % 97) - 48.5f;
+            FloatB[i] = (i % 89) * 0.5f + 1.0f;
+            IntA[i] = (i * 7919) ^ (i << 3);
+            IntB[i] = (i % 3 == 0) ? IntA[i] : i * 31;
+            ShortA[i] = (short)(i * 37 - 20000);
+        }
+    }
+
+    static void Check(string name, bool correct)
+    {
+        if (!correct)
+        {
+            Console.WriteLine("FAILED: VectorOps." + name);
+            Failed = true;
+        }
+    }
+
+    static bool Near(float expected, float actual)
+    {
+        return Math.Abs(expected - actual) <= 1e-3f * Math.Max(1.0f, Math.Abs(expected));
+    }
+
+    static void CheckAll()
+    {
+        bool correct;
+
+        NamedArithmetic(FloatA, FloatB, FloatOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            float x = FloatA[i], y = FloatB[i];
+            correct &= Near((x + y) * (x - y) / y, FloatOut[i]);
+        }
+        Check("NamedArithmetic", correct);
+
+        NamedBitwise(IntA, IntB, IntOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= ((IntA[i] & IntB[i]) ^ (IntA[i] | IntB[i])) == IntOut[i];
+        }
+        Check("NamedBitwise", correct);
+
+        AndNot(IntA, IntB, IntOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= (IntA[i] & ~IntB[i]) == IntOut[i];
+        }
+        Check("AndNot", correct);
+
+        OnesComplement(IntA, IntOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= ~IntA[i] == IntOut[i];
+        }
+        Check("OnesComplement", correct);
+
+        Negate(FloatA, FloatOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= -FloatA[i] == FloatOut[i];
+        }
+        Check("Negate", correct);
+
+        Compare(FloatA, FloatB, IntA, IntB, IntOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            int count = 0;
+            count += (FloatA[i] > FloatB[i]) ? 1 : 0;
+            count += (FloatA[i] >= FloatB[i]) ? 1 : 0;
+            count += (IntA[i] < IntB[i]) ? 1 : 0;
+            count += (IntA[i] <= IntB[i]) ? 1 : 0;
+            correct &= count == IntOut[i];
+        }
+        Check("Compare", correct);
+
+        EqualsMask(IntA, IntB, IntOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= ((IntA[i] == IntB[i]) ? -1 : 0) == IntOut[i];
+        }
+        Check("EqualsMask", correct);
+
+        ConditionalSelect(FloatA, FloatB, FloatOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= Math.Max(FloatA[i], FloatB[i]) == FloatOut[i];
+        }
+        Check("ConditionalSelect", correct);
+
+        // The vector sum adds the products in another order, so allow for
+        // rounding relative to the size of the products.
+        float dot = 0, magnitude = 0;
+        for (int i = 0; i < Length; i++)
+        {
+            dot += FloatA[i] * FloatB[i];
+            magnitude += Math.Abs(FloatA[i] * FloatB[i]);
+        }
+        Check("Dot", Math.Abs(dot - Dot(FloatA, FloatB)) <= 1e-4f * magnitude);
+
+        Widen(ShortA, IntOut);
+        correct = true;
+        int half = Vector<int>.Count;
+        for (int i = 0; i < Length; i += 2 * half)
+        {
+            for (int j = 0; j < half; j++)
+            {
+                correct &= (ShortA[i + j] + ShortA[i + half + j]) == IntOut[i / 2 + j];
+            }
+        }
+        Check("Widen", correct);
+
+        Narrow(IntA, ShortOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= (short)IntA[i] == ShortOut[i];
+        }
+        Check("Narrow", correct);
+
+        Convert(IntA, FloatB, FloatOut);
+        correct = true;
+        for (int i = 0; i < Length; i++)
+        {
+            correct &= Near((float)IntA[i] + (float)(int)FloatB[i], FloatOut[i]);
+        }
+        Check("Convert", correct);
+
+        int equalities = 0;
+        int lanes = Vector<float>.Count;
+        for (int i = 0; i < Length; i += lanes)
+        {
+            bool equal = true, allFirst = true;
+            for (int j = 0; j < lanes; j++)
+            {
+                equal &= FloatA[i + j] == FloatB[i + j];
+                allFirst &= FloatA[i + j] == FloatA[0];
+            }
+            equalities += (equal ? 2 : 0) + (allFirst ? 0 : 1);
+        }
+        Check("VectorEquality", equalities == VectorEquality(FloatA, FloatB));
+    }
+
+    static void Time(string name, int iterations, Action benchmark)
+    {
+        Stopwatch watch = Stopwatch.StartNew();
+        for (int i = 0; i < iterations; i++)
+        {
+            benchmark();
+        }
+        watch.Stop();
+        Console.WriteLine("VectorOps." + name + ": " +
+                          watch.Elapsed.TotalMilliseconds.ToString("F3") +
+                          " ms");
+    }
+
+    public static int Main(string[] args)
+    {
+        int iterations = (args.Length > 0) ? int.Parse(args[0]) : 1000;
+        Console.WriteLine("IsHardwareAccelerated: " +
+                          Vector.IsHardwareAccelerated);
+
+        Initialize();
+        CheckAll();
+        if (Failed)
+        {
+            return 1;
+        }
+
+        Time("NamedArithmetic", iterations,
+             () => NamedArithmetic(FloatA, FloatB, FloatOut));
+        Time("NamedBitwise", iterations, () => NamedBitwise(IntA, IntB, IntOut));
+        Time("AndNot", iterations, () => AndNot(IntA, IntB, IntOut));
+        Time("OnesComplement", iterations, () => OnesComplement(IntA, IntOut));
+        Time("Negate", iterations, () => Negate(FloatA, FloatOut));
+        Time("Compare", iterations,
+             () => Compare(FloatA, FloatB, IntA, IntB, IntOut));
+        Time("EqualsMask", iterations, () => EqualsMask(IntA, IntB, IntOut));
+        Time("ConditionalSelect", iterations,
+             () => ConditionalSelect(FloatA, FloatB, FloatOut));
+        Time("Dot", iterations, () => Dot(FloatA, FloatB));
+        Time("Widen", iterations, () => Widen(ShortA, IntOut));
+        Time("Narrow", iterations, () => Narrow(IntA, ShortOut));
+        Time("Convert", iterations, () => Convert(IntA, FloatB, FloatOut));
+        Time("VectorEquality", iterations, () => VectorEquality(FloatA, FloatB));
+        return 100;
+    }
+}
@@ -0,0 +1,270 @@
+#!/usr/bin/env python
+#
+# title           : llilc_replay.py
+# description     : Record the jit requests a managed application makes and
+#                   replay them against LLILC without the runtime.
+#
+# This script has been tested running on both Python 2.7 and Python 3.4.
+#
+# usage: llilc_replay.py collect [-h] [-v] -a APP_PATH -c CORECLR_RUNTIME_PATH
+#                                -j JIT_PATH -s SUPERPMI_PATH -o OUTPUT
+#                                [-x [EXTRA [EXTRA ...]]]
+#        llilc_replay.py replay [-h] [-v] -j JIT_PATH -s SUPERPMI_PATH
+#                               -i INPUT [-m METHODS] [-t TIME_LOG]
+#                               [-f FAILURE_LIST] [-x [EXTRA [EXTRA ...]]]
+#        llilc_replay.py compare [-h] [-n COUNT] BASE_TIME_LOG DIFF_TIME_LOG
+#
+# The recording and replaying is done by CoreCLR's SuperPMI tools, which are
+# built along with CoreCLR and track the JIT-EE interface that LLILC is built
+# against. Every query the jit makes of ICorJitInfo and ICorJitHost while
+# compiling a method, along with the answer, is saved in a method context.
+# Replaying a collection calls compileMethod on LLILC once per method context,
+# answering the jit's queries from the recording, so no runtime is needed.
+#
+# collect runs the application under CoreCLR with the SuperPMI collector
+# standing in for the jit. The collector loads LLILC and records each jit
+# request in a method context file, and the files are then merged into a
+# single collection.
+#
+# replay compiles the methods in a collection with LLILC. The methods are
+# numbered from 1 in the order they were recorded, and -m restricts the
+# replay to some of them, as in 1,3-5. This is how a failure or a throughput
+# problem is bisected down to a single method. With -t, LLILC appends a line
+# of JSON giving the time spent in each phase for each method it compiles
+# (see COMPlus_LLILCTimeLog in Documentation/Debugging.md).
+#
+# compare reads the time logs from replays of the same collection with two
+# jits, and reports the total time of each and the methods whose compile
+# time changed the most.
+#
+# Jit options given with -x override those recorded with the method contexts.
+# Background jitting and the object cache are always disabled when
+# replaying, since neither works without the runtime.
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+
+llilcverbose = False
+
+def GetPrintString(*args):
+    return ' '.join(map(str, args))
+
+def Print(*args):
+    print (GetPrintString(*args))
+
+def PrintError(*args):
+    sys.stderr.write(GetPrintString(*args) + '\n')
+
+def log(*objs):
+    '''Print log message to both stdout and stderr'''
+    Print("llilc_replay\stdout: ", *objs)
+    PrintError("llilc_replay\stderr: ", *objs)
+
+def RunCommand(command):
+    ''' Run a command and return its exit code, optionally echoing it.'''
+    global llilcverbose
+    if llilcverbose:
+        log ('About to execute: ', command)
+    error_level = subprocess.call(command)
+    return error_level
+
+def SharedLibraryName(name):
+    ''' Return the file name of the shared library with the given base name.'''
+    if sys.platform.startswith('win'):
+        return name + '.dll'
+    if sys.platform == 'darwin':
+        return 'lib' + name + '.dylib'
+    return 'lib' + name + '.so'
+
+def ExecutableName(name):
+    if sys.platform.startswith('win'):
+        return name + '.exe'
+    return name
+
+def Collect(args):
+    ''' Run the application with the SuperPMI collector as the jit and merge
+        the method contexts it records into a single collection.'''
+    log_dir = args.output + '.mc'
+    if os.path.exists(log_dir):
+        shutil.rmtree(log_dir)
+    os.makedirs(log_dir)
+
+    collector_name = SharedLibraryName('superpmi-shim-collector')
+    collector_path = os.path.join(args.coreclr_runtime_path, collector_name)
+    shutil.copy2(os.path.join(args.superpmi_path, collector_name),
+                 collector_path)
+
+    os.environ["SuperPMIShimLogPath"]=log_dir
+    os.environ["SuperPMIShimPath"]=os.path.abspath(args.jit_path)
+    os.environ["COMPlus_AltJit"]="*"
+    os.environ["COMPlus_AltJitName"]=collector_name
+    os.environ["COMPlus_NoGuiOnAssert"]="1"
+    os.environ["COMPlus_ZapDisable"]="1"
+    os.environ["COMPlus_GCConservative"]="1"
+    for arg in args.extra:
+        pair = arg.split('=', 1)
+        os.environ['COMPlus_' + pair[0]] = pair[1]
+    os.environ["CORE_ROOT"]=args.coreclr_runtime_path
+    os.environ["CORE_LIBRARIES"]=os.path.dirname(args.app_path)
+
+    command = [os.path.join(args.coreclr_runtime_path,
+                            ExecutableName('corerun')), args.app_path]
+    command.extend(args.app_args)
+    error_level = RunCommand(command)
+    if error_level != 0:
+        log('application exited with ', error_level)
+
+    mcs = os.path.join(args.superpmi_path, ExecutableName('mcs'))
+    merge_error_level = RunCommand([mcs, '-merge', args.output,
+                                    os.path.join(log_dir, '*.mc')])
+    if merge_error_level != 0:
+        log('failed to merge the method contexts in ', log_dir)
+        return merge_error_level
+    shutil.rmtree(log_dir)
+    return error_level
+
+def Replay(args):
+    ''' Compile the methods in a collection with LLILC.'''
+    options = ['LLILCBackgroundJit=0', 'LLILCObjectCache=']
+    if args.time_log:
+        options.append('LLILCTimeLog=' + os.path.abspath(args.time_log))
+    options.extend(args.extra)
+
+    command = [os.path.join(args.superpmi_path, ExecutableName('superpmi'))]
+    for option in options:
+        command.extend(['-jitoption', 'force', option])
+    if args.methods:
+        command.extend(['-c', args.methods])
+    if args.failure_list:
+        command.extend(['-f', args.failure_list])
+    command.extend([os.path.abspath(args.jit_path), args.input])
+    return RunCommand(command)
+
+def ReadTimeLog(path):
+    ''' Return a map from method name to total milliseconds spent jitting it,
+        along with the total over all the methods. The debuginfo phase is
+        left out of the sums since it is timed within codegen.'''
+    times = {}
+    total = 0.0
+    with open(path) as time_log:
+        for line in time_log:
+            record = json.loads(line)
+            method_time = sum(phase['wall_ms']
+                              for name, phase in record['phases'].items()
+                              if name != 'debuginfo')
+            name = record['method']
+            times[name] = times.get(name, 0.0) + method_time
+            total += method_time
+    return times, total
+
+def Compare(args):
+    ''' Report the change in jit time between two replays.'''
+    base_times, base_total = ReadTimeLog(args.base_time_log)
+    diff_times, diff_total = ReadTimeLog(args.diff_time_log)
+    Print('base: %d methods, %.3f ms' % (len(base_times), base_total))
+    Print('diff: %d methods, %.3f ms' % (len(diff_times), diff_total))
+    if base_total > 0:
+        Print('change: %+.2f%%' % ((diff_total - base_total) * 100 / base_total))
+
+    changes = []
+    for name in base_times:
+        if name in diff_times:
+            changes.append((diff_times[name] - base_times[name], name))
+    changes.sort(key=lambda change: abs(change[0]), reverse=True)
+    Print('')
+    Print('largest changes (ms):')
+    for change, name in changes[:args.count]:
+        Print('%+10.3f %10.3f  %s' % (change, base_times[name], name))
+
+    only_base = len([name for name in base_times if name not in diff_times])
+    only_diff = len([name for name in diff_times if name not in base_times])
+    if only_base or only_diff:
+        Print('')
+        Print('%d methods only in base, %d only in diff' % (only_base, only_diff))
+    return 0
+
+def main(argv):
+    '''
+    main method of script. arguments are script path and remaining arguments.
+    '''
+    global llilcverbose
+    parser = argparse.ArgumentParser(description='''Record the jit requests a managed
+                                     application makes and replay them against LLILC
+                                     without the runtime.
+                                     ''')
+    subparsers = parser.add_subparsers(dest='command')
+
+    collect = subparsers.add_parser('collect', help='''run an application and record its
+                                    jit requests. If the application has any arguments,
+                                    they must be appended to the end of the command line,
+                                    preceded by "--".
+                                    ''')
+    collect.add_argument('-v', '--verbose', help='echo commands', default=False, action="store_true")
+    collect.add_argument('-x', '--extra', type=str, default=[], nargs='*',
+                         help='''list of extra COMPlus settings. Each item is Name=Value, where
+                                 Name does not have the COMPlus_ prefix.
+                              ''')
+    required = collect.add_argument_group('required arguments')
+    required.add_argument('-a', '--app-path', type=str, required=True,
+                          help='full path to application to run.')
+    required.add_argument('-c', '--coreclr-runtime-path', required=True,
+                          help='full path to CoreCLR run-time binary directory')
+    required.add_argument('-j', '--jit-path', type=str, required=True,
+                          help='full path to the LLILC jit.')
+    required.add_argument('-s', '--superpmi-path', type=str, required=True,
+                          help='full path to the directory holding the SuperPMI tools.')
+    required.add_argument('-o', '--output', type=str, required=True,
+                          help='collection file to write.')
+
+    replay = subparsers.add_parser('replay', help='compile the methods in a collection.')
+    replay.add_argument('-v', '--verbose', help='echo commands', default=False, action="store_true")
+    replay.add_argument('-m', '--methods', type=str,
+                        help='methods to compile, by number, as in 1,3-5.')
+    replay.add_argument('-t', '--time-log', type=str,
+                        help='file to append the time spent on each method to.')
+    replay.add_argument('-f', '--failure-list', type=str,
+                        help='file to write the numbers of the methods that failed to.')
+    replay.add_argument('-x', '--extra', type=str, default=[], nargs='*',
+                        help='''list of jit options to use in place of those recorded. Each
+                                item is Name=Value, where Name does not have the COMPlus_
+                                prefix.
+                             ''')
+    required = replay.add_argument_group('required arguments')
+    required.add_argument('-j', '--jit-path', type=str, required=True,
+                          help='full path to the LLILC jit.')
+    required.add_argument('-s', '--superpmi-path', type=str, required=True,
+                          help='full path to the directory holding the SuperPMI tools.')
+    required.add_argument('-i', '--input', type=str, required=True,
+                          help='collection file to replay.')
+
+    compare = subparsers.add_parser('compare', help='compare the time logs of two replays.')
+    compare.add_argument('-n', '--count', type=int, default=20,
+                         help='number of methods to report.')
+    compare.add_argument('base_time_log', help='time log from the baseline jit.')
+    compare.add_argument('diff_time_log', help='time log from the jit being measured.')
+
+    # Everything after a separating '--' belongs to the application.
+    app_args = []
+    if '--' in argv:
+        app_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    args = parser.parse_args(argv)
+    args.app_args = app_args
+    llilcverbose = getattr(args, 'verbose', False)
+
+    if args.command == 'collect':
+        return Collect(args)
+    if args.command == 'replay':
+        return Replay(args)
+    if args.command == 'compare':
+        return Compare(args)
+    parser.print_help()
+    return 1
+
+if __name__ == '__main__':
+    return_code = main(sys.argv[1:])
+    sys.exit(return_code)
@@ -0,0 +1,217 @@
+#!/usr/bin/env python
+#
+# title           : llilc_simdbench.py
+# description     : Check that LLILC vectorizes the System.Numerics vector
+#                   operations it expands inline, and time them.
+#
+# This script has been tested running on both Python 2.7 and Python 3.4.
+#
+# usage: llilc_simdbench.py [-h] [-v] [-j JIT_PATH] [-n ITERATIONS]
+#                           -a APP_PATH -c CORECLR_RUNTIME_PATH
+#
+# The application is test/SIMD/VectorOps.cs, built against the CoreCLR
+# runtime's System.Numerics.Vectors. It has one benchmark method per group
+# of vector operations, and checks their results against scalar loops
+# before timing them.
+#
+# The application is first run through llilc_run.py with
+# COMPlus_AltJitLLVMDump naming its class, and the LLVM IR of each benchmark
+# method is searched for the vector instructions its operations should be
+# expanded to. A method that still calls the managed implementation of an
+# operation fails the check.
+#
+# The benchmarks are then timed with the vector operations expanded, which
+# is the default, and again with COMPlus_DisableSIMDIntrinsic set, and the
+# times are reported side by side.
+#
+# The exit code is 0 if the results are correct and every benchmark is
+# vectorized.
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+llilcverbose = False
+
+# The instructions that each benchmark method must contain once its vector
+# operations are expanded. <N x T> is a vector of any length.
+ExpectedPatterns = {
+    'NamedArithmetic': ['load <N x float>', 'fadd <N x float>',
+                        'fsub <N x float>', 'fmul <N x float>',
+                        'fdiv <N x float>'],
+    'NamedBitwise': ['and <N x i32>', 'or <N x i32>', 'xor <N x i32>'],
+    'AndNot': ['xor <N x i32>', 'and <N x i32>'],
+    'OnesComplement': ['xor <N x i32>'],
+    'Negate': ['fsub <N x float> <float -0'],
+    'Compare': ['fcmp ogt <N x float>', 'fcmp oge <N x float>',
+                'icmp slt <N x i32>', 'icmp sle <N x i32>',
+                'sext <N x i1>'],
+    'EqualsMask': ['icmp eq <N x i32>', 'sext <N x i1>'],
+    'ConditionalSelect': ['fcmp ogt <N x float>', 'and <N x i32>',
+                          'or <N x i32>'],
+    'Dot': ['fmul <N x float>', 'shufflevector <N x float>',
+            'extractelement <N x float>'],
+    'Widen': ['shufflevector <N x i16>', 'sext <N x i16>'],
+    'Narrow': ['trunc <N x i32>', 'shufflevector <N x i16>'],
+    'Convert': ['sitofp <N x i32>', 'fptosi <N x float>'],
+    'VectorEquality': ['fcmp oeq <N x float>', 'bitcast <N x i1>',
+                       'xor i1'],
+}
+
+def GetPrintString(*args):
+    return ' '.join(map(str, args))
+
+def Print(*args):
+    print (GetPrintString(*args))
+
+def PrintError(*args):
+    sys.stderr.write(GetPrintString(*args) + '\n')
+
+def log(*objs):
+    '''Print log message to both stdout and stderr'''
+    Print("llilc_simdbench\stdout: ", *objs)
+    PrintError("llilc_simdbench\stderr: ", *objs)
+
+def RunApp(args, extra, iterations):
+    ''' Run the application with LLILC through llilc_run.py, and return its
+        exit code along with what it wrote to stdout and stderr.'''
+    global llilcverbose
+    command = [sys.executable,
+               os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            'llilc_run.py'),
+               '-a', args.app_path, '-c', args.coreclr_runtime_path]
+    if args.jit_path:
+        command.extend(['-j', args.jit_path])
+    if extra:
+        command.append('-x')
+        command.extend(extra)
+    command.extend(['--', str(iterations)])
+    if llilcverbose:
+        log('About to execute: ', command)
+    process = subprocess.Popen(command, stdout=subprocess.PIPE,
+                               stderr=subprocess.PIPE,
+                               universal_newlines=True)
+    output, errors = process.communicate()
+    return process.returncode, output, errors
+
+def SplitDumps(dump):
+    ''' Return a map from method name to the LLVM IR dumped for it.'''
+    dumps = {}
+    name = None
+    for line in dump.splitlines():
+        match = re.match(r'INFO:  Dumping LLVM for method (\S+)', line)
+        if match:
+            name = match.group(1)
+            dumps[name] = []
+        elif line.startswith('INFO:'):
+            name = None
+        elif name:
+            dumps[name].append(line)
+    return dict((name, '\n'.join(lines)) for name, lines in dumps.items())
+
+def PatternRegex(pattern):
+    ''' Turn an expected instruction into a regular expression, where N
+        stands for any vector length.'''
+    return re.escape(pattern).replace('N', r'\d+')
+
+def CheckVectorized(args):
+    ''' Check the IR of each benchmark method for its vector instructions.
+        Return the number of benchmarks that are not vectorized.'''
+    exit_code, output, errors = RunApp(args, ['AltJitLLVMDump=VectorOps:'], 1)
+    if exit_code != 100:
+        log('VectorOps failed with exit code ', exit_code)
+        Print(output)
+        return len(ExpectedPatterns)
+
+    dumps = SplitDumps(errors)
+    failures = 0
+    for bench in sorted(ExpectedPatterns):
+        ir = dumps.get('VectorOps.' + bench)
+        if ir is None:
+            Print('%-20s not jitted by LLILC' % bench)
+            failures += 1
+            continue
+        missing = [pattern for pattern in ExpectedPatterns[bench]
+                   if not re.search(PatternRegex(pattern), ir)]
+        if missing:
+            Print('%-20s missing %s' % (bench, ', '.join(missing)))
+            failures += 1
+        else:
+            Print('%-20s vectorized' % bench)
+    return failures
+
+def ReadTimes(output):
+    ''' Return a map from benchmark name to the milliseconds it took.'''
+    times = {}
+    for line in output.splitlines():
+        match = re.match(r'VectorOps\.(\w+): ([0-9.]+) ms', line)
+        if match:
+            times[match.group(1)] = float(match.group(2))
+    return times
+
+def Time(args):
+    ''' Time the benchmarks with and without the vector operations
+        expanded, and report both.'''
+    exit_code, output, errors = RunApp(args, [], args.iterations)
+    if exit_code != 100:
+        log('VectorOps failed with exit code ', exit_code)
+        return 1
+    simd_times = ReadTimes(output)
+    exit_code, output, errors = RunApp(args, ['DisableSIMDIntrinsic=1'],
+                                       args.iterations)
+    if exit_code != 100:
+        log('VectorOps failed with exit code ', exit_code,
+            ' with SIMD disabled')
+        return 1
+    scalar_times = ReadTimes(output)
+
+    Print('')
+    Print('%-20s %12s %12s %8s' % ('benchmark', 'simd (ms)', 'no simd (ms)',
+                                   'speedup'))
+    for bench in sorted(ExpectedPatterns):
+        if bench not in simd_times or bench not in scalar_times:
+            continue
+        simd = simd_times[bench]
+        scalar = scalar_times[bench]
+        speedup = (scalar / simd) if simd > 0 else 0.0
+        Print('%-20s %12.3f %12.3f %7.2fx' % (bench, simd, scalar, speedup))
+    return 0
+
+def main(argv):
+    '''
+    main method of script. arguments are script path and remaining arguments.
+    '''
+    global llilcverbose
+    parser = argparse.ArgumentParser(description='''Check that LLILC vectorizes the
+                                     System.Numerics vector operations, and time them
+                                     with and without SIMD.
+                                     ''')
+    parser.add_argument('-v', '--verbose', help='echo commands', default=False, action="store_true")
+    parser.add_argument('-j', '--jit-path', type=str,
+                        help='''full path to the LLILC jit. If given it is copied to the
+                                coreclr directory.
+                             ''')
+    parser.add_argument('-n', '--iterations', type=int, default=1000,
+                        help='number of times to run each benchmark.')
+    required = parser.add_argument_group('required arguments')
+    required.add_argument('-a', '--app-path', type=str, required=True,
+                          help='full path to the built VectorOps application.')
+    required.add_argument('-c', '--coreclr-runtime-path', required=True,
+                          help='full path to CoreCLR run-time binary directory')
+    args = parser.parse_args(argv)
+    llilcverbose = args.verbose
+
+    failures = CheckVectorized(args)
+    if Time(args) != 0:
+        return 1
+    if failures:
+        Print('')
+        Print('%d benchmarks are not vectorized' % failures)
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    return_code = main(sys.argv[1:])
+    sys.exit(return_code)